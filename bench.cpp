@@ -0,0 +1,382 @@
+/* mbed TM1638 Benchmarks, for TM1638 LED controller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "mbed.h"
+#include "TM1638.h"
+#include "TM1638_Bus.h"
+#include "TM1638_Anim.h"
+#include "TM1638_Dim.h"
+#include "TM1638_Number.h"
+#include "bench.h"
+
+#if (BENCH_TEST == 1)
+
+//Number of frames per measurement
+#define BENCH_FRAMES     200
+
+//CS pins of the modules chained on the test panel
+static const PinName bench_cs[] = {D10, D9, D8, D7, D6, D5};
+#define BENCH_MAX_MODULES (sizeof(bench_cs) / sizeof(bench_cs[0]))
+
+//Two alternating frames, every byte changes so the diff-only write sends full frames
+static TM1638::DisplayData_t bench_frame[2] = {
+  {0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03},
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+
+/** Time BENCH_FRAMES rounds of one full frame + one key scan per module
+ *  @param  TM1638 **module Array of modules
+ *  @param  int modules number of modules
+ *  @return int elapsed time in us
+ */
+static int bench_rounds(TM1638 **module, int modules) {
+  Timer timer;
+  TM1638::KeyData_t keydata;
+
+  timer.start();
+  for (int frame=0; frame < BENCH_FRAMES; frame++) {
+    for (int idx=0; idx < modules; idx++) {
+      module[idx]->writeData(bench_frame[frame & 1]);
+      module[idx]->getKeys(&keydata);
+    }
+  }
+  timer.stop();
+
+  return (int) timer.elapsed_time().count();
+}
+
+
+/** Aggregate frames per second of N modules on one TM1638_Bus,
+ *  compared with N modules that each own an SPI object
+ */
+void bench_bus() {
+  TM1638 *module[BENCH_MAX_MODULES];
+  int us_shared, us_own;
+
+  printf("\r\nTM1638_Bus: %d frames per module, frame = 16 bytes + key scan\r\n", BENCH_FRAMES);
+  printf("modules   shared bus fps   own SPI fps\r\n");
+
+  for (int modules=1; modules <= (int) BENCH_MAX_MODULES; modules++) {
+    {
+      // All modules share one SPI object, format and frequency are set once
+      TM1638_SPIBus bus(D11, D12, D13);
+      for (int idx=0; idx < modules; idx++) {
+        module[idx] = new TM1638(bus, bench_cs[idx]);
+      }
+      us_shared = bench_rounds(module, modules);
+      for (int idx=0; idx < modules; idx++) {
+        delete module[idx];
+      }
+    }
+
+    // Each module owns an SPI object on the same pins, the peripheral is reconfigured when ownership changes
+    for (int idx=0; idx < modules; idx++) {
+      module[idx] = new TM1638(D11, D12, D13, bench_cs[idx]);
+    }
+    us_own = bench_rounds(module, modules);
+    for (int idx=0; idx < modules; idx++) {
+      delete module[idx];
+    }
+
+    printf("%7d   %14d   %11d\r\n", modules,
+           (int) ((1000000LL * BENCH_FRAMES * modules) / us_shared),
+           (int) ((1000000LL * BENCH_FRAMES * modules) / us_own));
+  }
+}
+
+
+/** Display write and key read throughput of the bit-banged bus compared with the SPI bus
+ *  The GPIO bus module is wired to DIO = D2, CLK = D3, STB = D4
+ */
+void bench_gpio() {
+  TM1638 *module;
+  TM1638::KeyData_t keydata;
+  Timer timer;
+  int us_frames, us_keys;
+
+  printf("\r\nBus throughput: %d frames of 16 bytes, %d key scans\r\n", BENCH_FRAMES, BENCH_FRAMES);
+  printf("bus            frame bytes/s   key scans/s\r\n");
+
+  for (int bus=0; bus < 2; bus++) {
+    TM1638_SPIBus  spibus(D11, D12, D13);
+    TM1638_GPIOBus gpiobus(D2, D3);
+
+    if (bus == 0) {
+      module = new TM1638(spibus, D10);
+    }
+    else {
+      module = new TM1638(gpiobus, D4);
+    }
+
+    timer.reset();
+    timer.start();
+    for (int frame=0; frame < BENCH_FRAMES; frame++) {
+      module->writeData(bench_frame[frame & 1]);
+    }
+    timer.stop();
+    us_frames = (int) timer.elapsed_time().count();
+
+    timer.reset();
+    timer.start();
+    for (int frame=0; frame < BENCH_FRAMES; frame++) {
+      module->getKeys(&keydata);
+    }
+    timer.stop();
+    us_keys = (int) timer.elapsed_time().count();
+
+    delete module;
+
+    printf("%-12s   %13d   %11d\r\n", (bus == 0) ? "SPI 500kHz" : "GPIO 2000ns",
+           (int) ((1000000LL * BENCH_FRAMES * TM1638_DISPLAY_MEM) / us_frames),
+           (int) ((1000000LL * BENCH_FRAMES) / us_keys));
+  }
+}
+
+
+//Chase animation: all segments, segment A through the digits, B, C, segment D back and E, F
+#define BENCH_ANIM_FRAMES  21
+static TM1638::DisplayData_t bench_anim_raw[BENCH_ANIM_FRAMES];
+static uint8_t bench_anim_data[BENCH_ANIM_FRAMES * TM1638_ANIM_MAX_FRAME];
+
+
+/** Flash size and decode cost of a delta animation compared with raw frames
+ *  The module is wired to the SPI bus with CS = D10
+ */
+void bench_anim() {
+  TM1638_SPIBus bus(D11, D12, D13);
+  TM1638 module(bus, D10);
+  TM1638_Animator animator(module);
+  EventQueue queue;  // never dispatched, the frames are stepped directly
+  TM1638_Animator::Animation_t raw = {bench_anim_raw, NULL, BENCH_ANIM_FRAMES, 1};
+  TM1638_Animator::DeltaAnimation_t delta = {bench_anim_data, NULL, BENCH_ANIM_FRAMES, 1};
+  char work[TM1638_DISPLAY_MEM];
+  volatile char sink = 0;
+  int size, offset, first, last, frame;
+  int us_raw, us_delta;
+  Timer timer;
+
+  memset(bench_anim_raw, 0, sizeof(bench_anim_raw));
+  memset(bench_anim_raw[0], 0xFF, TM1638_DISPLAY_MEM);
+  for (frame=1; frame <= 8; frame++) {
+    bench_anim_raw[frame][(frame - 1) * 2] = S7_A;
+  }
+  bench_anim_raw[9][14]  = S7_B;
+  bench_anim_raw[10][14] = S7_C;
+  for (frame=11; frame <= 18; frame++) {
+    bench_anim_raw[frame][(18 - frame) * 2] = S7_D;
+  }
+  bench_anim_raw[19][0] = S7_E;
+  bench_anim_raw[20][0] = S7_F;
+
+  size = 0;
+  for (frame=0; frame < BENCH_ANIM_FRAMES; frame++) {
+    size += TM1638_Animator::encodeFrame((frame == 0) ? NULL : bench_anim_raw[frame - 1], bench_anim_raw[frame], &bench_anim_data[size]);
+  }
+
+  printf("\r\nAnimation: %d frames\r\n", BENCH_ANIM_FRAMES);
+  printf("format   flash bytes   fetch ns/frame   play us/frame\r\n");
+
+  // Fetch cost: copy a raw frame or apply the deltas of a frame
+  timer.start();
+  for (int round=0; round < BENCH_FRAMES; round++) {
+    for (frame=0; frame < BENCH_ANIM_FRAMES; frame++) {
+      memcpy(work, bench_anim_raw[frame], TM1638_DISPLAY_MEM);
+      sink = sink + work[frame & (TM1638_DISPLAY_MEM - 1)];
+    }
+  }
+  timer.stop();
+  us_raw = (int) timer.elapsed_time().count();
+
+  timer.reset();
+  timer.start();
+  for (int round=0; round < BENCH_FRAMES; round++) {
+    offset = 0;
+    for (frame=0; frame < BENCH_ANIM_FRAMES; frame++) {
+      offset += TM1638_Animator::decodeFrame(&bench_anim_data[offset], work, &first, &last);
+      sink = sink + work[frame & (TM1638_DISPLAY_MEM - 1)];
+    }
+  }
+  timer.stop();
+  us_delta = (int) timer.elapsed_time().count();
+
+  printf("raw      %11d   %14d", BENCH_ANIM_FRAMES * TM1638_DISPLAY_MEM,
+         (int) ((1000LL * us_raw) / (BENCH_FRAMES * BENCH_ANIM_FRAMES)));
+
+  // Play cost: fetch and diff-only write over SPI
+  animator.setQueue(&queue);
+  animator.play(raw, TM1638_Animator::ANIM_LOOP);
+  timer.reset();
+  timer.start();
+  for (int round=0; round < BENCH_FRAMES; round++) {
+    animator.step();
+  }
+  timer.stop();
+  animator.cancel();
+  printf("   %13d\r\n", (int) (timer.elapsed_time().count() / BENCH_FRAMES));
+
+  printf("delta    %11d   %14d", size,
+         (int) ((1000LL * us_delta) / (BENCH_FRAMES * BENCH_ANIM_FRAMES)));
+
+  animator.play(delta, TM1638_Animator::ANIM_LOOP);
+  timer.reset();
+  timer.start();
+  for (int round=0; round < BENCH_FRAMES; round++) {
+    animator.step();
+  }
+  timer.stop();
+  animator.cancel();
+  printf("   %13d\r\n", (int) (timer.elapsed_time().count() / BENCH_FRAMES));
+}
+
+
+/** Worst case subframe write time and the flicker-free brightness levels of the dimmer
+ *  The module is wired to the SPI bus with CS = D10
+ */
+void bench_dim() {
+  TM1638_SPIBus bus(D11, D12, D13);
+  TM1638 module(bus, D10);
+  Timer timer;
+  int us_frame, period, refresh;
+
+  // Worst case subframe: every byte toggles
+  timer.start();
+  for (int frame=0; frame < BENCH_FRAMES; frame++) {
+    module.writeData(bench_frame[frame & 1]);
+  }
+  timer.stop();
+  us_frame = (int) (timer.elapsed_time().count() / BENCH_FRAMES);
+
+  // The subframe period is a whole number of ms and must leave time for the write
+  period = (us_frame / 1000) + 1;
+
+  printf("\r\nDimmer: worst case subframe %d us, shortest period %d ms\r\n", us_frame, period);
+  printf("levels   refresh Hz   flicker-free (>= %d Hz)\r\n", TM1638_DIM_MIN_HZ);
+
+  for (int levels=2; levels <= TM1638_DIM_MAX_LEVELS; levels *= 2) {
+    refresh = 1000 / (levels * period);
+    printf("%6d   %10d   %s\r\n", levels, refresh, (refresh >= TM1638_DIM_MIN_HZ) ? "yes" : "no");
+  }
+
+  // The default period, as the dimmer selects it when started
+  TM1638_Dimmer dimmer(module);
+  dimmer.calibrate();
+  printf("TM1638_Dimmer default: subframe %d us, period %d ms, %d levels at %d Hz\r\n",
+         dimmer.getSubframeTime(), dimmer.getPeriod(), dimmer.getLevels(), dimmer.getRefreshRate());
+}
+
+
+//Numbers per format measurement
+#define BENCH_NUMBERS    1000
+
+/** Convert a time for BENCH_NUMBERS numbers to CPU cycles per number
+ *  @param  int us elapsed time in us
+ *  @return int cycles
+ */
+static int bench_cycles(int us) {
+  return (int) (((long long) us * (SystemCoreClock / 1000000)) / BENCH_NUMBERS);
+}
+
+
+/** Cycles per number of the printf-free renderers compared with formatting by printf
+ *  The LEDKEY8 module is wired to the SPI bus with CS = D10
+ */
+void bench_number() {
+#if (LEDKEY8_TEST == 1)
+  TM1638_SPIBus bus(D11, D12, D13);
+  TM1638_LEDKEY8 module(bus, D10);
+  char text[16], patterns[LEDKEY8_NR_DIGITS];
+  volatile char sink = 0;
+  int us_printf, us_render, idx;
+  Timer timer;
+
+  printf("\r\nNumbers: %d per format, cycles per number at %lu MHz\r\n", BENCH_NUMBERS, (unsigned long) (SystemCoreClock / 1000000));
+  printf("format           snprintf + render   TM1638_Number\r\n");
+
+  for (int format=0; format < 3; format++) {
+    // Text: libc formatting, then characters to patterns
+    timer.reset();
+    timer.start();
+    for (idx=0; idx < BENCH_NUMBERS; idx++) {
+      switch (format) {
+        case 0:  snprintf(text, sizeof(text), "%8d", idx * 7919 - 3000000); break;
+        case 1:  snprintf(text, sizeof(text), "%08X", idx * 7919U); break;
+        default: snprintf(text, sizeof(text), "%9.3f", idx * 1.001f - 500.0f); break;
+      }
+      module.renderString(text, strlen(text), patterns, LEDKEY8_NR_DIGITS);
+      sink = sink + patterns[idx & (LEDKEY8_NR_DIGITS - 1)];
+    }
+    timer.stop();
+    us_printf = (int) timer.elapsed_time().count();
+
+    // Patterns straight from the number
+    timer.reset();
+    timer.start();
+    for (idx=0; idx < BENCH_NUMBERS; idx++) {
+      switch (format) {
+        case 0:  TM1638_Number::renderInt(idx * 7919 - 3000000, patterns, LEDKEY8_NR_DIGITS); break;
+        case 1:  TM1638_Number::renderHex(idx * 7919U, patterns, LEDKEY8_NR_DIGITS, TM1638_Number::NUM_ZERO); break;
+        default: TM1638_Number::renderFloat(idx * 1.001f - 500.0f, 3, patterns, LEDKEY8_NR_DIGITS); break;
+      }
+      sink = sink + patterns[idx & (LEDKEY8_NR_DIGITS - 1)];
+    }
+    timer.stop();
+    us_render = (int) timer.elapsed_time().count();
+
+    printf("%-14s   %17d   %13d\r\n", (format == 0) ? "int %8d" : (format == 1) ? "hex %08X" : "float %9.3f",
+           bench_cycles(us_printf), bench_cycles(us_render));
+  }
+
+  // Complete path including the display write
+  printf("display write    displayStringAt     displayPatterns\r\n");
+
+  timer.reset();
+  timer.start();
+  for (idx=0; idx < BENCH_NUMBERS; idx++) {
+    snprintf(text, sizeof(text), "%9.3f", idx * 1.001f - 500.0f);
+    module.displayStringAt(text, 0);
+  }
+  timer.stop();
+  us_printf = (int) timer.elapsed_time().count();
+
+  timer.reset();
+  timer.start();
+  for (idx=0; idx < BENCH_NUMBERS; idx++) {
+    module.displayPatterns(patterns, TM1638_Number::renderFloat(idx * 1.001f - 500.0f, 3, patterns, LEDKEY8_NR_DIGITS));
+  }
+  timer.stop();
+  us_render = (int) timer.elapsed_time().count();
+
+  printf("%-14s   %17d   %13d\r\n", "float %9.3f", bench_cycles(us_printf), bench_cycles(us_render));
+#endif
+}
+
+
+/** Run all benchmarks and print the results on the console
+ */
+void bench_run() {
+  bench_bus();
+  bench_gpio();
+  bench_anim();
+  bench_dim();
+  bench_number();
+}
+
+#endif
@@ -0,0 +1,58 @@
+/* mbed TM1638 Benchmarks, for TM1638 LED controller
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#ifndef BENCH_H
+#define BENCH_H
+
+#include "TM1638_Config.h"
+
+#if (BENCH_TEST == 1)
+/** Run all benchmarks and print the results on the console
+ */
+void bench_run();
+
+/** Aggregate frames per second of N modules on one TM1638_Bus,
+ *  compared with N modules that each own an SPI object
+ */
+void bench_bus();
+
+/** Display write and key read throughput of the bit-banged bus compared with the SPI bus
+ */
+void bench_gpio();
+
+/** Flash size and decode cost of a delta animation compared with raw frames
+ */
+void bench_anim();
+
+/** Worst case subframe write time and the flicker-free brightness levels of the dimmer
+ */
+void bench_dim();
+
+/** Cycles per number of the printf-free renderers compared with formatting by printf
+ *
+ *  Code size is not measured at run time. Compare the linker map of the application with the numbers
+ *  formatted by printf and by TM1638_Number: without float formatting through printf the floating point
+ *  support of the minimal printf ("target.printf_lib": "minimal-printf", "platform.minimal-printf-enable-floating-point": false)
+ *  can be left out, or the newlib _vfprintf_r and _dtoa_r drop out of the link when no printf is used at all.
+ */
+void bench_number();
+#endif
+
+#endif
@@ -43,10 +43,12 @@ const char MASK_ICON_GRID[][2] = {
 //#define FONT_7S_START     0x20
 //#define FONT_7S_END       0x7F
 //#define FONT_7S_NR_CHARS (FONT_7_END - FONT_7S_START + 1)
+//
+// The table is stored as bytes, a glyph that does not fit in the 8 bits of a digit fails to compile (narrowing)
 
 #if (SHOW_ASCII == 1)
 //display all ASCII characters
-const short FONT_7S[]  = { 
+const uint8_t FONT_7S[] = { 
                              C7_SPC, //32 0x20, Space
                              C7_EXC,
                              C7_QTE,
@@ -147,7 +149,7 @@ const short FONT_7S[]  = {
  
 #else
 //display only digits and hex characters
-const short FONT_7S[] = { 
+const uint8_t FONT_7S[] = { 
                            C7_0, //48 0x30
                            C7_1,
                            C7_2,
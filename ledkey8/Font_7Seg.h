@@ -24,6 +24,8 @@
 #ifndef MBED_FONT_7SEG_H
 #define MBED_FONT_7SEG_H
 
+#include <stdint.h>
+
 // Select one of the testboards for TM1638 controller
 #include "TM1638_Config.h"
 
@@ -463,10 +465,11 @@ extern const char MASK_ICON_GRID[][2];
 
 
 // ASCII Font definition table
+// One byte per character, the segment mapping of the selected board is folded in by the C7_ defines above
 //
 #define FONT_7S_START     0x20
 #define FONT_7S_END       0x7F
 //#define FONT_7S_NR_CHARS (FONT_7S_END - FONT_7S_START + 1)
-extern const short FONT_7S[]; 
+extern const uint8_t FONT_7S[]; 
 
 #endif    
\ No newline at end of file
@@ -21,56 +21,157 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
-#include "mbed.h" 
 #include "TM1638.h"
-
+#include "TM1638_Bus.h"
+#include "TM1638_Latency.h"
+
+//Lookup table for runtime bitreversal, generated at compile time
+#define TM1638_REV8_X16(n) TM1638_REV8(n + 0x0), TM1638_REV8(n + 0x1), TM1638_REV8(n + 0x2), TM1638_REV8(n + 0x3), \
+                           TM1638_REV8(n + 0x4), TM1638_REV8(n + 0x5), TM1638_REV8(n + 0x6), TM1638_REV8(n + 0x7), \
+                           TM1638_REV8(n + 0x8), TM1638_REV8(n + 0x9), TM1638_REV8(n + 0xA), TM1638_REV8(n + 0xB), \
+                           TM1638_REV8(n + 0xC), TM1638_REV8(n + 0xD), TM1638_REV8(n + 0xE), TM1638_REV8(n + 0xF)
+
+const char TM1638_FLIP[256] = {
+  TM1638_REV8_X16(0x00), TM1638_REV8_X16(0x10), TM1638_REV8_X16(0x20), TM1638_REV8_X16(0x30),
+  TM1638_REV8_X16(0x40), TM1638_REV8_X16(0x50), TM1638_REV8_X16(0x60), TM1638_REV8_X16(0x70),
+  TM1638_REV8_X16(0x80), TM1638_REV8_X16(0x90), TM1638_REV8_X16(0xA0), TM1638_REV8_X16(0xB0),
+  TM1638_REV8_X16(0xC0), TM1638_REV8_X16(0xD0), TM1638_REV8_X16(0xE0), TM1638_REV8_X16(0xF0)
+};
+
+#if defined(__MBED__)
 /** Constructor for class for driving TM1638 LED controller with SPI bus interface device. 
  *  @brief Supports 8 digits @ 10 segments. 
  *         Also supports a scanned keyboard of upto 24 keys.
  *   
  *  @param  PinName mosi, miso, sclk, cs SPI bus pins
 */
-TM1638::TM1638(PinName mosi, PinName miso, PinName sclk, PinName cs) : _spi(mosi,miso,sclk), _cs(cs) {
+TM1638::TM1638(PinName mosi, PinName miso, PinName sclk, PinName cs) {
+
+  // Private bus for this module
+  _bus    = new TM1638_SPIBus(mosi, miso, sclk);
+  _ownBus = true;
+  _slot   = _bus->attach(this, cs);
+
+  _init();
+}
+#endif
+
+/** Constructor for class for driving TM1638 LED controller on a shared bus
+ *
+ *  @param  TM1638_Bus &bus Shared SPI bus
+ *  @param  PinName cs CS pin of this module
+*/
+TM1638::TM1638(TM1638_Bus &bus, PinName cs) {
+
+  _bus    = &bus;
+  _ownBus = false;
+  _slot   = _bus->attach(this, cs);
 
   _init();
 }
 
-/** Init the SPI interface and the controller
+/** Destructor for class for driving TM1638 LED controller
+ */
+TM1638::~TM1638() {
+  // service() must not reach this module anymore
+  _bus->detach(_slot);
+
+  if (_ownBus) {
+    delete _bus;
+  }
+}
+
+/** Init the controller
   * @param  none
   * @return none
   */ 
 void TM1638::_init(){
-  
-//init SPI
-  _cs=1;
-  _spi.format(8,3); //TM1638 uses mode 3 (Clock High on Idle, Data latched on second (=rising) edge)
-  _spi.frequency(500000);   
+
+  if (_slot < 0) {
+    error("TM1638: too many modules on bus\r\n");
+  }
+
+//init shadow memory, controller content is unknown after powerup
+  invalidate();
+  resetFlushStats();
+
+//init local displaybuffer
+  for (int cnt=0; cnt<TM1638_DISPLAY_MEM; cnt++) {
+    _displaybuffer[cnt] = 0x00;
+  }
+  _updateDepth = 0;
+  _frameDepth  = 0;
+  _deferred    = false;
+
+  memset(_frontbuffer, 0, TM1638_DISPLAY_MEM);
+  _presentPending = false;
+  _presenting     = false;
+
+//all keys of the matrix in packed order, the derived classes set the keys on the board
+  _keyMask     = TM1638_KEYS_MSK;
+  _keyMap      = NULL;
+  _nrKeys      = TM1638_KEY_MEM * 8;
 
 //init controller  
   _display = TM1638_DSP_ON;
   _bright  = TM1638_BRT_DEF; 
-  _writeCmd(TM1638_DSP_CTRL_CMD, _display | _bright );                                 // Display control cmd, display on/off, brightness   
-  
-  _writeCmd(TM1638_DATA_SET_CMD, TM1638_DATA_WR | TM1638_ADDR_INC | TM1638_MODE_NORM); // Data set cmd, normal mode, auto incr, write data  
+  _dspCtrl = TM1638_STATE_UNKNOWN;
+  _dataSet = TM1638_STATE_UNKNOWN;
+  _setDspCtrl();       // Display control cmd, display on/off, brightness   
+
+  // Data set cmd is sent by the first display write
 }   
 
 
 /** Clear the screen and locate to 0
  */  
 void TM1638::cls() {
-  
-  _cs=0;
-  wait_us(1);    
-  _spi.write(_flip(TM1638_ADDR_SET_CMD | 0x00)); // Address set cmd, 0
-      
+
   for (int cnt=0; cnt<TM1638_DISPLAY_MEM; cnt++) {
-    _spi.write(0x00); // data 
+    _displaybuffer[cnt] = 0x00;
   }
-  
-  wait_us(1);
-  _cs=1;      
+
+  _updateData(TM1638_DISPLAY_MEM, 0);
 }  
 
+
+/** Number of screen columns, the boards with digits override this
+  *  @param  none
+  *  @return int columns, 0 for a controller without digits
+  */
+int TM1638::columns() {
+  return 0;
+}
+
+
+/** Render a string to digit patterns without writing the display, the boards with digits override this
+  *  @param  const char *str characters to render, need not be terminated
+  *  @param  int length number of characters in str
+  *  @param  char *patterns destination for one segment pattern per digit
+  *  @param  int size max number of digits in patterns
+  *  @return int number of digits rendered, 0 for a controller without digits
+  */
+int TM1638::renderString(const char *str, int length, char *patterns, int size) {
+  (void) str;
+  (void) length;
+  (void) patterns;
+  (void) size;
+  return 0;
+}
+
+
+/** Display digit patterns starting at a screen column, the boards with digits override this
+  *  @param  const char *patterns one segment pattern per digit
+  *  @param  int digits number of patterns
+  *  @param  int column start column, indexed from 0
+  *  @return int column following the last digit written
+  */
+int TM1638::displayPatterns(const char *patterns, int digits, int column) {
+  (void) patterns;
+  (void) digits;
+  return column;
+}
+
 /** Set Brightness
   *
   * @param  char brightness (3 significant bits, valid range 0..7 (1/16 .. 14/14 dutycycle)  
@@ -80,7 +181,7 @@ void TM1638::setBrightness(char brightness){
 
   _bright = brightness & TM1638_BRT_MSK; // mask invalid bits
   
-  _writeCmd(TM1638_DSP_CTRL_CMD, _display | _bright );  // Display control cmd, display on/off, brightness  
+  _setDspCtrl();  // Display control cmd, display on/off, brightness  
 }
 
 /** Set the Display mode On/off
@@ -96,24 +197,36 @@ void TM1638::setDisplay(bool on) {
     _display = TM1638_DSP_OFF;
   }
   
-  _writeCmd(TM1638_DSP_CTRL_CMD, _display | _bright );  // Display control cmd, display on/off, brightness   
+  _setDspCtrl();  // Display control cmd, display on/off, brightness   
+}
+
+/** Set the Display mode On/off and the Brightness with one display control cmd
+  *
+  * @param  bool on display mode
+  * @param  char brightness (3 significant bits, valid range 0..7 (1/16 .. 14/16 dutycycle)
+  * @return none
+  */
+void TM1638::setDisplay(bool on, char brightness) {
+
+  _display = (on) ? TM1638_DSP_ON : TM1638_DSP_OFF;
+  _bright  = brightness & TM1638_BRT_MSK; // mask invalid bits
+
+  _setDspCtrl();  // Display control cmd, display on/off, brightness
 }
 
 
 /** Write databyte to TM1638
   *  @param  char data byte written at given address
   *  @param  int address display memory location to write byte
-  *  @return none
+  *  @return int number of bytes saved (1 when the controller already holds this byte)
   */ 
-void TM1638::writeData(char data, int address) {
-  _cs=0;
-  wait_us(1);    
-  _spi.write(_flip(TM1638_ADDR_SET_CMD | (address & TM1638_ADDR_MSK))); // Set Address cmd
-      
-  _spi.write(_flip(data)); // data 
-  
-  wait_us(1);
-  _cs=1;             
+int TM1638::writeData(char data, int address) {
+  char buffer[TM1638_DISPLAY_MEM];
+
+  address &= TM1638_ADDR_MSK;
+  buffer[address] = data;
+
+  return writeData(buffer, 1, address);
 }
 
 
@@ -121,126 +234,680 @@ void TM1638::writeData(char data, int address) {
   *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for displaydata
   *  @param  length number bytes to write (valid range 0..TM1638_DISPLAY_MEM (=16), when starting at address 0)
   *  @param  int address display memory location to write bytes (default = 0)   
-  *  @return none
+  *  @return int number of bytes saved compared to writing the full block
   */ 
-void TM1638::writeData(DisplayData_t data, int length, int address) {
-  _cs=0;
-  wait_us(1);    
-       
+int TM1638::writeData(const DisplayData_t data, int length, int address) {
+  return _flush(data, length, address, TM1638_MERGE_GAP);
+}
+
+
+/** Start a batch of display updates
+  *  @param  none
+  *  @return none
+  */
+void TM1638::beginUpdate() {
+  _updateDepth++;
+}
+
+
+/** End a batch of display updates
+  *  @param  none
+  *  @return none
+  */
+void TM1638::commit() {
+  if (_updateDepth > 0) {
+    _updateDepth--;
+  }
+
+  if ((_updateDepth == 0) && !_inFrame() && !_deferred) {
+    // Send all changes since beginUpdate() as one auto-increment burst,
+    // or as fixed address writes when only a few scattered bytes changed
+    _flush(_displaybuffer, TM1638_DISPLAY_MEM, 0, TM1638_DISPLAY_MEM);
+  }
+}
+
+
+/** Start drawing a frame in the back buffer
+  *  @param  none
+  *  @return none
+  */
+void TM1638::beginFrame() {
+  uint32_t depth;
+
+  // One producer draws at a time, released by present()
+  _frameMutex.lock();
+  depth = core_util_atomic_load_u32(&_frameDepth);
+
+  if (depth == 0) {
+    // While the back buffer is drawn, the front frame holds what is on display
+    _frontMutex.lock();
+    memcpy(_frontbuffer, _displaybuffer, TM1638_DISPLAY_MEM);
+    core_util_atomic_store_u32(&_frameDepth, 1);
+    _frontMutex.unlock();
+  }
+  else {
+    core_util_atomic_store_u32(&_frameDepth, depth + 1);
+  }
+}
+
+
+/** Present the frame drawn since beginFrame(), only the differences with the controller memory are sent
+  *  @param  none
+  *  @return none
+  */
+void TM1638::present() {
+  DisplayData_t frame;
+  uint32_t depth;
+
+  // Waits while another producer draws a frame. Once locked, an open frame belongs to this thread.
+  _frameMutex.lock();
+  depth = core_util_atomic_load_u32(&_frameDepth);
+  if (depth > 0) {
+    depth--;
+    _frameMutex.unlock();    // Lock taken by beginFrame()
+  }
+
+  // A nested frame is presented by the outermost present()
+  if (depth > 0) {
+    core_util_atomic_store_u32(&_frameDepth, depth);
+    _frameMutex.unlock();
+    return;
+  }
+
+  // Swap: the completed back buffer becomes the front frame, and the frame is closed at once
+  _frontMutex.lock();
+  memcpy(_frontbuffer, _displaybuffer, TM1638_DISPLAY_MEM);
+  core_util_atomic_store_u32(&_frameDepth, 0);
+  _frameMutex.unlock();
+
+  // Deferred: the frame stays in the displaybuffer for the owner of the display writes (eg TM1638_Dimmer)
+  if (_deferred) {
+    _frontMutex.unlock();
+    return;
+  }
+  _presentPending = true;
+
+  // A thread that is sending an earlier frame sends this one next
+  if (_presenting) {
+    _frontMutex.unlock();
+    return;
+  }
+  _presenting = true;
+
+  while (_presentPending) {
+    _presentPending = false;
+    memcpy(frame, _frontbuffer, TM1638_DISPLAY_MEM);
+    _frontMutex.unlock();
+
+    _flush(frame, TM1638_DISPLAY_MEM, 0, TM1638_DISPLAY_MEM);
+
+    _frontMutex.lock();
+  }
+
+  _presenting = false;
+  _frontMutex.unlock();
+}
+
+
+/** Write a range of the local displaybuffer, unless a batch of updates is in progress
+  *  @param  int length number of bytes to write
+  *  @param  int address display memory location to write bytes
+  *  @return none
+  */
+void TM1638::_updateData(int length, int address) {
+  if ((_updateDepth == 0) && !_inFrame() && !_deferred) {
+    writeData(_displaybuffer, length, address);
+  }
+}
+
+
+/** Send all changes in the local displaybuffer that the controller does not hold yet
+  *  @param  none
+  *  @return none
+  */
+void TM1638::flush() {
+  if ((_updateDepth == 0) && !_inFrame()) {
+    writeData(_displaybuffer, TM1638_DISPLAY_MEM, 0);
+  }
+}
+
+
+/** Write the changed bytes of a display datablock to TM1638
+  *  @param  const char *data Array of display data, indexed by address
+  *  @param  int length number bytes to write
+  *  @param  int address display memory location to write bytes
+  *  @param  int maxgap largest number of unchanged bytes bridged within one burst
+  *  @return int number of bytes saved compared to writing the full block
+  */
+int TM1638::_flush(const char *data, int length, int address, int maxgap) {
+  int runFirst[TM1638_DISPLAY_MEM], runLength[TM1638_DISPLAY_MEM];
+  int runs, dirty, sent;
+  int idx, end, first, last, gap;
+  int incCost, fixedCost;
+
 // sanity check
   address &= TM1638_ADDR_MSK;
   if (length < 0) {length = 0;}
   if ((length + address) > TM1638_DISPLAY_MEM) {length = (TM1638_DISPLAY_MEM - address);}
 
-  // _spi.write(_flip(TM1638_ADDR_SET_CMD | 0x00)); // Set Address at 0
-  _spi.write(_flip(TM1638_ADDR_SET_CMD | address)); // Set Address
+  // Keep the shadow copy and the controller mode consistent with other threads using the bus
+  _bus->lock();
+
+  runs  = 0;
+  dirty = 0;
+  idx   = address;
+  end   = address + length;
+
+  while (idx < end) {
+    // Skip bytes that the controller already holds
+    if (!_isDirty(idx, data[idx])) {
+      idx++;
+      continue;
+    }
+
+    // Extend the burst, bridging short gaps of clean bytes
+    first = idx;
+    last  = idx;
+    gap   = 0;
+    dirty++;
+    for (idx = first + 1; idx < end; idx++) {
+      if (_isDirty(idx, data[idx])) {
+        last = idx;
+        gap  = 0;
+        dirty++;
+      }
+      else if (++gap > maxgap) {
+        break;
+      }
+    }
+
+    runFirst[runs]  = first;
+    runLength[runs] = last - first + 1;
+    runs++;
+    idx = last + 1;
+  }
+
+  // Bus cost of both write strategies, in byte times
+  incCost   = 0;
+  for (int run=0; run<runs; run++) {
+    incCost += TM1638_CS_COST + 1 + runLength[run];  // Address set cmd + data burst
+  }
+  fixedCost = dirty * (TM1638_CS_COST + 2);          // Address set cmd + single data byte, cheaper when a wide span holds few dirty bytes
+  if (_dataSet != TM1638_DATA_WR_INC)   {incCost   += TM1638_CS_COST + 1;} // Data set cmd to switch mode
+  if (_dataSet != TM1638_DATA_WR_FIXED) {fixedCost += TM1638_CS_COST + 1;}
+
+  sent = 0;
+  if (runs == 0) {
+    // Nothing to send
+  }
+  else if ((fixedCost < incCost) || ((fixedCost == incCost) && (_dataSet == TM1638_DATA_WR_FIXED))) {
+    // Sparse update, write only the changed bytes in fixed address mode
+    _setAddrMode(TM1638_ADDR_FIXED);
+    for (int run=0; run<runs; run++) {
+      for (idx=runFirst[run]; idx<(runFirst[run] + runLength[run]); idx++) {
+        if (_isDirty(idx, data[idx])) {
+          _writeBurst(data, idx, 1);
+          sent++;
+        }
+      }
+    }
+    _stats.fixedWrites++;
+  }
+  else {
+    // Dense update, write the merged ranges in auto-increment mode
+    _setAddrMode(TM1638_ADDR_INC);
+    for (int run=0; run<runs; run++) {
+      _writeBurst(data, runFirst[run], runLength[run]);
+      sent += runLength[run];
+    }
+    _stats.incWrites++;
+  }
+
+  _stats.flushes++;
+  _stats.requested += length;
+  _stats.sent      += sent;
+  _stats.saved     += (length - sent);
+  _stats.lastSaved  = (length - sent);
+
+#if (TM1638_LATENCY == 1)
+  if (sent > 0) {
+    TM1638_latency.flushed();
+  }
+#endif
+
+  _bus->unlock();
+
+  return (length - sent);
+}
+
+
+/** Select the address mode for display writes, the data set cmd is only sent when the mode changes
+  *  @param  char mode TM1638_ADDR_INC or TM1638_ADDR_FIXED
+  *  @return none
+  */
+void TM1638::_setAddrMode(char mode) {
+  char data = TM1638_DATA_WR | mode | TM1638_MODE_NORM;
+
+  if (_dataSet != data) {
+    _writeCmd(TM1638_DATA_SET_CMD, data); // Data set cmd, normal mode, write data
+    _dataSet = data;
+  }
+  else {
+    _stats.cmdsSkipped++;
+  }
+}
+
 
-  for (int idx=0; idx<length; idx++) {    
-    //_spi.write(_flip(data[idx])); // data 
-    _spi.write(_flip(data[address + idx])); // data 
+/** Send the display control cmd when display on/off or brightness has changed
+  *  @param  none
+  *  @return none
+  */
+void TM1638::_setDspCtrl() {
+  char data = _display | _bright;
+
+  _bus->lock();
+
+  if (_dspCtrl != data) {
+    _writeCmd(TM1638_DSP_CTRL_CMD, data); // Display control cmd, display on/off, brightness
+    _dspCtrl = data;
+  }
+  else {
+    _stats.cmdsSkipped++;
+  }
+
+  _bus->unlock();
+}
+
+
+/** Write one auto-increment burst of display data and update the shadow copy
+  *  @param  const char *data Array of display data, indexed by address
+  *  @param  int address first display memory location
+  *  @param  int length number of bytes to write
+  *  @return none
+  */
+void TM1638::_writeBurst(const char *data, int address, int length) {
+  _bus->select(_slot);
+
+  _bus->write(TM1638_ADDR_SET_CMD_W | _flip(address)); // Set Address
+
+  for (int idx=address; idx<(address + length); idx++) {    
+    _bus->write(_flip(data[idx])); // data 
+
+    _shadow[idx]  = data[idx];
+    _shadowValid |= (1 << idx);
   }
   
-  wait_us(1);
-  _cs=1;             
+  _bus->deselect(_slot);
+
+  _stats.bursts++;
+}
+
+
+#if DEVICE_SPI_ASYNCH
+/** Write Display datablock to TM1638 without blocking the caller
+  *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for displaydata
+  *  @param  done Callback invoked with the SPI event when the burst has been sent (optional), from interrupt context or the caller's thread
+  *  @param  length number bytes to write (valid range 0..TM1638_DISPLAY_MEM (=16), when starting at address 0)
+  *  @param  int address display memory location to write bytes (default = 0)
+  *  @return bool true when the burst was queued (or nothing had changed), false when a previous burst is still busy
+  */
+bool TM1638::writeDataAsync(const DisplayData_t data, const event_callback_t &done, int length, int address) {
+  int first, last, nr;
+
+  _bus->lock();
+
+  if (_bus->isBusy()) {
+    _bus->unlock();
+    return false;
+  }
+
+// sanity check
+  address &= TM1638_ADDR_MSK;
+  if (length < 0) {length = 0;}
+  if ((length + address) > TM1638_DISPLAY_MEM) {length = (TM1638_DISPLAY_MEM - address);}
+
+  // Find the changed span, a single burst covers it
+  first = address + length;
+  last  = address - 1;
+  for (int idx=address; idx<(address + length); idx++) {
+    if (_isDirty(idx, data[idx])) {
+      if (idx < first) {first = idx;}
+      last = idx;
+    }
+  }
+  nr = last - first + 1;
+
+  _stats.flushes++;
+  _stats.requested += length;
+
+  if (nr <= 0) {
+    // Nothing to send
+    _stats.saved    += length;
+    _stats.lastSaved = length;
+    _bus->unlock();
+    if (done) {
+      done(SPI_EVENT_COMPLETE);
+    }
+    return true;
+  }
+
+  // Prebuild the wire buffer and commit the span to the shadow copy
+  _txbuf[0] = TM1638_ADDR_SET_CMD_W | _flip(first); // Set Address
+  for (int idx=0; idx<nr; idx++) {
+    _txbuf[1 + idx] = _flip(data[first + idx]);   // data
+
+    _shadow[first + idx] = data[first + idx];
+    _shadowValid |= (1 << (first + idx));
+  }
+
+  _stats.sent     += nr;
+  _stats.saved    += (length - nr);
+  _stats.lastSaved = (length - nr);
+  _stats.bursts++;
+
+  // The prebuilt burst relies on auto-increment mode
+  _setAddrMode(TM1638_ADDR_INC);
+  _stats.incWrites++;
+
+#if (TM1638_LATENCY == 1)
+  // Stamp the completion, not the start of the burst
+  _asyncDone = done;
+  TM1638_latency.flushStarted();
+  if (!_bus->writeAsync(_slot, _txbuf, (1 + nr), callback(this, &TM1638::_asyncComplete))) {
+    TM1638_latency.flushFailed();
+#else
+  if (!_bus->writeAsync(_slot, _txbuf, (1 + nr), done)) {
+#endif
+    // Peripheral is busy, controller content is unknown
+    invalidate();
+    _bus->unlock();
+    return false;
+  }
+
+  _bus->unlock();
+  return true;
+}
+
+
+#if (TM1638_LATENCY == 1)
+/** Completion of an asynchronous burst, closes the latency measurement
+  *  @param  int event SPI event
+  *  @return none
+  */
+void TM1638::_asyncComplete(int event) {
+  TM1638_latency.flushCompleted();
+
+  if (_asyncDone) {
+    _asyncDone(event);
+  }
+}
+#endif
+
+
+/** Check for a pending asynchronous burst on the bus
+  *  @return bool busy
+  */
+bool TM1638::isBusy() const {
+  return _bus->isBusy();
+}
+#endif
+
+
+/** Copy the local displaybuffer, or the front frame while a frame is drawn
+  *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for the copy
+  *  @return none
+  */
+void TM1638::copyDisplayBuffer(DisplayData_t data) {
+  // A frame is only seen complete, never half drawn. The front mutex is only held for copies.
+  _frontMutex.lock();
+  memcpy(data, _inFrame() ? _frontbuffer : _displaybuffer, TM1638_DISPLAY_MEM);
+  _frontMutex.unlock();
+}
+
+
+/** Forget the shadow copy of the controller memory, the next write will send all requested bytes
+  *  @param  none
+  *  @return none
+  */
+void TM1638::invalidate() {
+  _shadowValid = 0x0000;
+}
+
+
+/** Reset the display write statistics
+  */
+void TM1638::resetFlushStats() {
+  _stats.flushes   = 0;
+  _stats.requested = 0;
+  _stats.sent      = 0;
+  _stats.saved     = 0;
+  _stats.bursts    = 0;
+  _stats.lastSaved = 0;
+  _stats.incWrites   = 0;
+  _stats.fixedWrites = 0;
+  _stats.cmdsSent    = 0;
+  _stats.cmdsSkipped = 0;
 }
 
 
 /** Read keydata block from TM1638
   *  @param  *keydata Ptr to Array of TM1638_KEY_MEM (=4) bytes for keydata
-  *  @return bool keypress True when at least one key was pressed
+  *  @return bool keypress True when at least one key is held for sure
   *
   * Note: Due to the hardware configuration the TM1638 key matrix scanner will detect multiple keys pressed at same time,
   *       but this may also result in some spurious keys being set in keypress data array.
-  *       It may be best to ignore all keys in those situations. That option is implemented in this method depending on #define setting.  
+  *       Chords are accepted, keys that may be a ghost of the chord are not counted as a keypress.
   */ 
 bool TM1638::getKeys(KeyData_t *keydata) {
-  int keypress = 0;
+
+  return ((decodeKeys(_readKeys(keydata)) & _keyMask) != 0);
+}
+
+
+/** Read the keys from TM1638 and decode chords
+  *  @param  uint32_t *held keys of this board that are pressed for sure, bit (byte index * 8) + bit of the keydata
+  *  @param  uint32_t *ambiguous keys of this board that are pressed or may be a ghost of a chord (optional)
+  *  @return bool keypress True when at least one key is held for sure
+  */ 
+bool TM1638::getKeys(uint32_t *held, uint32_t *ambiguous) {
+  KeyData_t keydata;
+  uint32_t keys, ghosts;
+
+  keys  = decodeKeys(_readKeys(&keydata), &ghosts) & _keyMask;
+  *held = mapKeys(keys);
+  if (ambiguous != NULL) {
+    *ambiguous = mapKeys(ghosts & _keyMask);
+  }
+
+  return (keys != 0);
+}
+
+
+/** Convert packed keydata to the logical key order of the board
+  *  @param  uint32_t keys packed keydata, bit (byte index * 8) + bit
+  *  @return uint32_t key state, bit 0 is SW1
+  */ 
+uint32_t TM1638::mapKeys(uint32_t keys) const {
+  uint32_t state = 0;
+
+  if ((_keyMap == NULL) || (keys == 0)) {
+    return keys;
+  }
+
+  for (int key=0; key < _nrKeys; key++) {
+    state |= ((keys >> _keyMap[key]) & 1) << key;
+  }
+
+  return state;
+}
+
+
+/** Set the key map of the board
+  *  @param  const uint8_t *map packed keydata bit of each key, SW1 first
+  *  @param  int keys number of keys
+  *  @return none
+  */ 
+void TM1638::_setKeyMap(const uint8_t *map, int keys) {
+  _keyMap  = map;
+  _nrKeys  = keys;
+  _keyMask = 0;
+
+  for (int key=0; key < keys; key++) {
+    _keyMask |= (1UL << map[key]);
+  }
+}
+
+
+/** Separate held keys from possible ghost keys in packed keydata
+  *  @param  uint32_t keys packed keydata as read, bit (byte index * 8) + bit
+  *  @param  uint32_t *ambiguous keys that are pressed or may be a ghost (optional)
+  *  @return uint32_t keys that are pressed for sure
+  */ 
+uint32_t TM1638::decodeKeys(uint32_t keys, uint32_t *ambiguous) {
+  uint32_t ghosts = 0;
+  uint32_t lines, shared;
+
+  keys &= TM1638_KEYS_MSK;
+
+  // A rectangle needs two scan lines that share at least two key lines
+  for (int scan=0; scan < (TM1638_MAX_NR_GRIDS - 1); scan++) {
+    lines = (keys >> (scan * 4)) & 0x07;
+    if ((lines & (lines - 1)) == 0) {
+      continue; // less than two keys on this scan line
+    }
+
+    for (int other=scan+1; other < TM1638_MAX_NR_GRIDS; other++) {
+      shared = lines & (keys >> (other * 4));
+      if (shared & (shared - 1)) {
+        ghosts |= (shared << (scan * 4)) | (shared << (other * 4));
+      }
+    }
+  }
+
+  if (ambiguous != NULL) {
+    *ambiguous = ghosts;
+  }
+
+  return (keys & ~ghosts);
+}
+
+
+/** Read keydata block from TM1638
+  *  @param  *keydata Ptr to Array of TM1638_KEY_MEM (=4) bytes for keydata, masked with TM1638_KEY_MSK
+  *  @return uint32_t packed keydata, bit (byte index * 8) + bit
+  */ 
+uint32_t TM1638::_readKeys(KeyData_t *keydata) {
+  uint32_t keys = 0;
   char data;
 
   // Read keys
-  _cs=0;
-  wait_us(1);    
+  _bus->lock();
+  _bus->select(_slot);
   
   // Enable Key Read mode
-  _spi.write(_flip(TM1638_DATA_SET_CMD | TM1638_KEY_RD | TM1638_ADDR_INC | TM1638_MODE_NORM)); // Data set cmd, normal mode, auto incr, read data
+  _bus->write(TM1638_KEY_RD_CMD_W); // Data set cmd, normal mode, auto incr, read data
 
   for (int idx=0; idx < TM1638_KEY_MEM; idx++) {
-    data = _flip(_spi.write(0xFF));    // read keys and correct bitorder
+    data = _flip(_bus->read());    // read keys and correct bitorder
 
     data = data & TM1638_KEY_MSK; // Mask valid bits
-    if (data != 0) {  // Check for any pressed key
-      for (int bit=0; bit < 8; bit++) {
-        if (data & (1 << bit)) {keypress++;} // Test all significant bits
-      }
-    }  
+    keys |= ((uint32_t) data) << (idx * 8);
 
     (*keydata)[idx] = data;            // Store keydata after correcting bitorder
   }
 
-  wait_us(1);
-  _cs=1;    
+  _bus->deselect(_slot);
 
-  // Restore Data Write mode
-  _writeCmd(TM1638_DATA_SET_CMD, TM1638_DATA_WR | TM1638_ADDR_INC | TM1638_MODE_NORM); // Data set cmd, normal mode, auto incr, write data  
-      
-#if(1)
-// Dismiss multiple keypresses at same time
-  return (keypress == 1);    
-#else
-// Allow multiple keypress and accept possible spurious keys
-  return (keypress > 0);
-#endif  
+  // Controller is left in Key Read mode, the next display write restores Data Write mode
+  _dataSet = TM1638_KEY_RD | TM1638_ADDR_INC | TM1638_MODE_NORM;
+
+  _bus->unlock();
+
+  return keys;
 }
     
 
-/** Helper to reverse all command or databits. The TM1638 expects LSB first, whereas SPI is MSB first
-  *  @param  char data
-  *  @return bitreversed data
-  */ 
-#if(1)
-char TM1638::_flip(char data) {
- char value=0;
-  
- if (data & 0x01) {value |= 0x80;} ;  
- if (data & 0x02) {value |= 0x40;} ;
- if (data & 0x04) {value |= 0x20;} ;
- if (data & 0x08) {value |= 0x10;} ;
- if (data & 0x10) {value |= 0x08;} ;
- if (data & 0x20) {value |= 0x04;} ;
- if (data & 0x40) {value |= 0x02;} ;
- if (data & 0x80) {value |= 0x01;} ;
- return value;       
-}
-#else
-char TM1638::_flip(char data) {
+/** Write command and parameter to TM1638
+  *  @param  int cmd Command byte
+  *  &Param  int data Parameters for command
+  *  @return none
+  */  
+void TM1638::_writeCmd(int cmd, int data){
+    
+  _bus->select(_slot);
+//  _bus->write(_flip( (cmd & 0xF0) | (data & 0x0F)));  
+  _bus->write(_flip( (cmd & TM1638_CMD_MSK) | (data & ~TM1638_CMD_MSK)));   
+ 
+  _bus->deselect(_slot);
+
+  _stats.cmdsSent++;
+}  
+
+
+/** Render a string to digit patterns, shared by the renderString() of the boards
+  *
+  *  @brief '.' and ',' are folded into the DP of the preceding digit, a leading or repeated DP
+  *         takes a digit of its own. Characters that can not be shown render as a blank digit.
+  *  @param  const char *str characters to render, need not be terminated
+  *  @param  int length number of characters in str
+  *  @param  char *patterns destination for one segment pattern per digit
+  *  @param  int size max number of digits in patterns
+  *  @param  char dp segment pattern of the decimal point
+  *  @return int number of digits rendered
+  */
+int TM1638::_renderString(const char *str, int length, char *patterns, int size, char dp) {
+  int idx, digits = 0;
+  bool hasDP = true;  // no digit to attach a DP to yet
+  char pattern;
+
+  for (idx=0; idx < length; idx++) {
+    if ((str[idx] == '.') || (str[idx] == ',')) {
+      if (!hasDP) {
+        //Add DP to the digit rendered just before
+        patterns[digits - 1] |= dp;
+        hasDP = true;
+        continue;
+      }
+      //Leading or repeated DP, show it on a digit of its own
+      pattern = dp;
+    }
+    else {
+      if (!_getPattern(str[idx], &pattern)) {
+        pattern = 0x00;
+      }
+      hasDP = false;
+    }
+
+    if (digits >= size) {
+      break;
+    }
+    patterns[digits++] = pattern;
+  }
 
- data   = (((data & 0xAA) >> 1) | ((data & 0x55) << 1));
- data   = (((data & 0xCC) >> 2) | ((data & 0x33) << 2));
- return   (((data & 0xF0) >> 4) | ((data & 0x0F) << 4));
+  return digits;
 }
-#endif
 
-/** Write command and parameter to TM1638
-  *  @param  int cmd Command byte
-  *  &Param  int data Parameters for command
-  *  @return none
-  */  
-void TM1638::_writeCmd(int cmd, int data){
-    
-  _cs=0;
-  wait_us(1);    
-//  _spi.write(_flip( (cmd & 0xF0) | (data & 0x0F)));  
-  _spi.write(_flip( (cmd & TM1638_CMD_MSK) | (data & ~TM1638_CMD_MSK)));   
- 
-  wait_us(1);
-  _cs=1;          
-}  
+
+/** Look up the segment pattern for a character, the boards with a font override this
+  *  @param  int value character
+  *  @param  char *pattern segment pattern
+  *  @return bool true when the character can be shown
+  */
+bool TM1638::_getPattern(int value, char *pattern) {
+  (void) value;
+  *pattern = 0x00;
+  return false;
+}
 
 
 #if (LEDKEY8_TEST == 1) 
 // Derived class for TM1638 used in LED&KEY display unit
 //
 
+//Key map of the board
+constexpr uint8_t TM1638_LEDKEY8::KEY_MAP[LEDKEY8_NR_KEYS];
+
+#if defined(__MBED__)
 /** Constructor for class for driving TM1638 LED controller as used in LEDKEY8
   *
   *  @brief Supports 8 Digits of 7 Segments + DP + LED Icons. Also supports a scanned keyboard of 8.
@@ -250,6 +917,19 @@ void TM1638::_writeCmd(int cmd, int data){
 TM1638_LEDKEY8::TM1638_LEDKEY8(PinName mosi, PinName miso, PinName sclk, PinName cs) : TM1638(mosi, miso, sclk, cs) {
   _column  = 0;
   _columns = LEDKEY8_NR_DIGITS;    
+  _setKeyMap(KEY_MAP, LEDKEY8_NR_KEYS);
+}  
+#endif
+
+/** Constructor for class for driving TM1638 LED controller as used in LEDKEY8 on a shared bus
+  *
+  *  @param  TM1638_Bus &bus Shared SPI bus
+  *  @param  PinName cs CS pin of this module
+  */
+TM1638_LEDKEY8::TM1638_LEDKEY8(TM1638_Bus &bus, PinName cs) : TM1638(bus, cs) {
+  _column  = 0;
+  _columns = LEDKEY8_NR_DIGITS;    
+  _setKeyMap(KEY_MAP, LEDKEY8_NR_KEYS);
 }  
 
 #if(0)
@@ -269,20 +949,97 @@ TM1638_LEDKEY8::TM1638_LEDKEY8(PinName mosi, PinName miso, PinName sclk, PinName
 #endif
 #endif
 
-/* Display a tring in ascii to the 8 digit seven segment display 
- * TODO start the string at the locate column
- *
- */
- void TM1638_LEDKEY8::displayStringAt(char *inString, int column) {
-    char outString[22];
-    for (int i = 0; i < (strlen( inString )) && i < 9; i++) {
-        outString[2*i] = FONT_7S[0x5f&inString[i]];
-        outString[2*i+1]= 0;
-    }
-    locate(column);
-    writeData(outString);
-  
- }
+/** Display a string starting at a screen column
+  *
+  *  @brief Characters are laid out directly into the displaybuffer, '.' and ',' are shown as the DP
+  *         of the preceding digit. Icons are preserved and only the digits covered by the string are written.
+  *         Characters that can not be shown leave a blank digit.
+  *  @param  const char *str characters to display, need not be terminated
+  *  @param  int length number of characters in str
+  *  @param  int column start column, indexed from 0
+  *  @return int column following the last digit written
+  */
+int TM1638_LEDKEY8::displayStringAt(const char *str, int length, int column) {
+  char patterns[LEDKEY8_NR_DIGITS];
+  int digits;
+
+  //sanity check
+  if (column < 0) {column = 0;}
+  if (column > LEDKEY8_NR_DIGITS) {column = LEDKEY8_NR_DIGITS;}
+
+  digits = renderString(str, length, patterns, LEDKEY8_NR_DIGITS - column);
+
+  return displayPatterns(patterns, digits, column);
+}
+
+
+/** Render a string to digit patterns without writing the display
+  *
+  *  @brief '.' and ',' are folded into the DP of the preceding digit, a leading or repeated DP
+  *         takes a digit of its own. Characters that can not be shown render as a blank digit.
+  *  @param  const char *str characters to render, need not be terminated
+  *  @param  int length number of characters in str
+  *  @param  char *patterns destination for one segment pattern per digit
+  *  @param  int size max number of digits in patterns
+  *  @return int number of digits rendered
+  */
+int TM1638_LEDKEY8::renderString(const char *str, int length, char *patterns, int size) {
+  return _renderString(str, length, patterns, size, S7_DP);
+}
+
+
+/** Display digit patterns starting at a screen column
+  *
+  *  @brief Icons are preserved and only the digits covered by the patterns are written.
+  *  @param  const char *patterns one segment pattern per digit
+  *  @param  int digits number of patterns
+  *  @param  int column start column, indexed from 0
+  *  @return int column following the last digit written
+  */
+int TM1638_LEDKEY8::displayPatterns(const char *patterns, int digits, int column) {
+  int first, addr;
+
+  //sanity check
+  if (column < 0) {column = 0;}
+  if (digits > (LEDKEY8_NR_DIGITS - column)) {digits = LEDKEY8_NR_DIGITS - column;}
+  first = column;
+
+  for (int idx=0; idx < digits; idx++, column++) {
+    addr = column << 1; // * TM1638_BYTES_PER_GRID
+
+    //Save icons...and set bits for character to write
+    _displaybuffer[addr] = (_displaybuffer[addr] & MASK_ICON_GRID[column][0]) | patterns[idx];
+  }
+
+  if (column > first) {
+    _updateData((column - first) * TM1638_BYTES_PER_GRID, first << 1);
+  }
+
+  //Update Cursor
+  _column = (column < LEDKEY8_NR_DIGITS) ? column : 0;
+
+  return column;
+}
+
+
+/** Display a zero terminated string starting at a screen column
+  *
+  *  @param  const char *str zero terminated string to display
+  *  @param  int column start column, indexed from 0
+  *  @return int column following the last digit written
+  */
+int TM1638_LEDKEY8::displayStringAt(const char *str, int column) {
+  int length = 0;
+
+  // No more than one digit and one DP per column can be shown
+  while ((length < (2 * LEDKEY8_NR_DIGITS)) && (str[length] != '\0')) {
+    length++;
+  }
+
+  return displayStringAt(str, length, column);
+}
+
+
 /** Locate cursor to a screen column
   *
   * @param column  The horizontal position from the left, indexed from 0
@@ -325,7 +1082,7 @@ void TM1638_LEDKEY8::cls(bool clrAll) {
     }  
   }
 
-  writeData(_displaybuffer, (LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID));
+  _updateData((LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID), 0);
 
   _column = 0;   
 }     
@@ -346,7 +1103,7 @@ void TM1638_LEDKEY8::setIcon(Icon icon) {
   _displaybuffer[addr]   = _displaybuffer[addr]   | LO(icn);      
   _displaybuffer[addr+1] = _displaybuffer[addr+1] | HI(icn);      
 //  writeData(_displaybuffer, (LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID));
-  writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);      
+  _updateData(TM1638_BYTES_PER_GRID, addr);      
 }
 
 /** Clr Icon
@@ -365,7 +1122,7 @@ void TM1638_LEDKEY8::clrIcon(Icon icon) {
   _displaybuffer[addr]   = _displaybuffer[addr]   & ~LO(icn);      
   _displaybuffer[addr+1] = _displaybuffer[addr+1] & ~HI(icn);      
 //  writeData(_displaybuffer, (LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID));
-  writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);      
+  _updateData(TM1638_BYTES_PER_GRID, addr);      
 }
 
 
@@ -416,47 +1173,14 @@ int TM1638_LEDKEY8::_putc(int value) {
 //        _displaybuffer[addr+1] = _displaybuffer[addr+1] | pattern;
 
 //        writeData(_displaybuffer, (LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID));
-        writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);    
+        _updateData(TM1638_BYTES_PER_GRID, addr);    
           
         //No Cursor Update
       }
     }
-    else if ((value >= 0) && (value < LEDKEY8_NR_UDC)) {
-      //Character to write
-      validChar = true;
-      pattern = _UDC_7S[value];
-    }  
-    
-#if (SHOW_ASCII == 1)
-    //display all ASCII characters
-    else if ((value >= FONT_7S_START) && (value <= FONT_7S_END)) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[value - FONT_7S_START];
-    } // else
-#else    
-    //display only digits and hex characters      
-    else if (value == '-') {
-      //Character to write
-      validChar = true;
-      pattern = C7_MIN;         
-    }
-    else if ((value >= (int)'0') && (value <= (int) '9')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[value - (int) '0'];
-    }
-    else if ((value >= (int) 'A') && (value <= (int) 'F')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[10 + value - (int) 'A'];
+    else {
+      validChar = _getPattern(value, &pattern);
     }
-    else if ((value >= (int) 'a') && (value <= (int) 'f')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[10 + value - (int) 'a'];
-    } //else
-#endif
 
     if (validChar) {
       //Character to write
@@ -469,7 +1193,7 @@ int TM1638_LEDKEY8::_putc(int value) {
 //      _displaybuffer[addr+1] = (_displaybuffer[addr+1] & MASK_ICON_GRID[_column][0]) | pattern;
 
 //      writeData(_displaybuffer, (LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID));
-      writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);
+      _updateData(TM1638_BYTES_PER_GRID, addr);
       
       //Update Cursor
       _column++;
@@ -488,6 +1212,48 @@ int TM1638_LEDKEY8::_getc() {
     return -1;
 }
 
+
+/** Look up the segment pattern for a character
+  *  @param  int value character
+  *  @param  char *pattern segment pattern
+  *  @return bool true when the character can be shown
+  */
+bool TM1638_LEDKEY8::_getPattern(int value, char *pattern) {
+
+    if ((value >= 0) && (value < LEDKEY8_NR_UDC)) {
+      *pattern = _UDC_7S[value];
+      return true;
+    }
+
+#if (SHOW_ASCII == 1)
+    //display all ASCII characters
+    if ((value >= FONT_7S_START) && (value <= FONT_7S_END)) {
+      *pattern = FONT_7S[value - FONT_7S_START];
+      return true;
+    }
+#else
+    //display only digits and hex characters
+    if (value == '-') {
+      *pattern = C7_MIN;
+      return true;
+    }
+    if ((value >= (int) '0') && (value <= (int) '9')) {
+      *pattern = FONT_7S[value - (int) '0'];
+      return true;
+    }
+    if ((value >= (int) 'A') && (value <= (int) 'F')) {
+      *pattern = FONT_7S[10 + value - (int) 'A'];
+      return true;
+    }
+    if ((value >= (int) 'a') && (value <= (int) 'f')) {
+      *pattern = FONT_7S[10 + value - (int) 'a'];
+      return true;
+    }
+#endif
+
+    return false;
+}
+
 #endif
 
 
@@ -495,6 +1261,10 @@ int TM1638_LEDKEY8::_getc() {
 // Derived class for TM1638 used in QYF-TM1638 display unit
 //
 
+//Key map of the board
+constexpr uint8_t TM1638_QYF::KEY_MAP[QYF_NR_KEYS];
+
+#if defined(__MBED__)
 /** Constructor for class for driving TM1638 LED controller as used in QYF
   *
   *  @brief Supports 8 Digits of 7 Segments + DP. Also supports a scanned keyboard of 16 keys.
@@ -504,6 +1274,19 @@ int TM1638_LEDKEY8::_getc() {
 TM1638_QYF::TM1638_QYF(PinName mosi, PinName miso, PinName sclk, PinName cs) : TM1638(mosi, miso, sclk, cs) {
   _column  = 0;
   _columns = QYF_NR_DIGITS;    
+  _setKeyMap(KEY_MAP, QYF_NR_KEYS);
+}  
+#endif
+
+/** Constructor for class for driving TM1638 LED controller as used in QYF on a shared bus
+  *
+  *  @param  TM1638_Bus &bus Shared SPI bus
+  *  @param  PinName cs CS pin of this module
+  */
+TM1638_QYF::TM1638_QYF(TM1638_Bus &bus, PinName cs) : TM1638(bus, cs) {
+  _column  = 0;
+  _columns = QYF_NR_DIGITS;    
+  _setKeyMap(KEY_MAP, QYF_NR_KEYS);
 }  
 
 #if(0)
@@ -523,6 +1306,129 @@ TM1638_QYF::TM1638_QYF(PinName mosi, PinName miso, PinName sclk, PinName cs) : T
 #endif
 #endif
 
+/** Display a string starting at a screen column
+  *
+  *  @brief The whole string is rendered to digit patterns first and converted to the segment-major
+  *         layout of this module in one step, the display is written once. '.' and ',' are shown as
+  *         the DP of the preceding digit. Characters that can not be shown leave a blank digit.
+  *  @param  const char *str characters to display, need not be terminated
+  *  @param  int length number of characters in str
+  *  @param  int column start column, indexed from 0
+  *  @return int column following the last digit written
+  */
+int TM1638_QYF::displayStringAt(const char *str, int length, int column) {
+  char patterns[QYF_NR_DIGITS];
+  int digits;
+
+  //sanity check
+  if (column < 0) {column = 0;}
+  if (column > QYF_NR_DIGITS) {column = QYF_NR_DIGITS;}
+
+  digits = renderString(str, length, patterns, QYF_NR_DIGITS - column);
+
+  return displayPatterns(patterns, digits, column);
+}
+
+
+/** Display a zero terminated string starting at a screen column
+  *
+  *  @param  const char *str zero terminated string to display
+  *  @param  int column start column, indexed from 0
+  *  @return int column following the last digit written
+  */
+int TM1638_QYF::displayStringAt(const char *str, int column) {
+  int length = 0;
+
+  // No more than one digit and one DP per column can be shown
+  while ((length < (2 * QYF_NR_DIGITS)) && (str[length] != '\0')) {
+    length++;
+  }
+
+  return displayStringAt(str, length, column);
+}
+
+
+/** Render a string to digit patterns without writing the display
+  *
+  *  @brief '.' and ',' are folded into the DP of the preceding digit, a leading or repeated DP
+  *         takes a digit of its own. Characters that can not be shown render as a blank digit.
+  *  @param  const char *str characters to render, need not be terminated
+  *  @param  int length number of characters in str
+  *  @param  char *patterns destination for one segment pattern per digit
+  *  @param  int size max number of digits in patterns
+  *  @return int number of digits rendered
+  */
+int TM1638_QYF::renderString(const char *str, int length, char *patterns, int size) {
+  return _renderString(str, length, patterns, size, S7_DP);
+}
+
+
+/** Display digit patterns starting at a screen column
+  *
+  *  @brief Only the digits covered by the patterns are written. The patterns are transposed
+  *         to the segment-major layout in one step.
+  *  @param  const char *patterns one segment pattern per digit
+  *  @param  int digits number of patterns
+  *  @param  int column start column, indexed from 0
+  *  @return int column following the last digit written
+  */
+int TM1638_QYF::displayPatterns(const char *patterns, int digits, int column) {
+  uint64_t frame = 0;
+  uint8_t columns = 0;
+  int first, shift;
+
+  //sanity check
+  if (column < 0) {column = 0;}
+  if (digits > (QYF_NR_DIGITS - column)) {digits = QYF_NR_DIGITS - column;}
+  first = column;
+
+  // Digit-major frame, the pattern for a column goes to row (7 - column) because
+  // the segment bit of Digit 1 is Bit7 and the one of Digit 8 is Bit0
+  for (int idx=0; idx < digits; idx++, column++) {
+    frame   |= (uint64_t) (uint8_t) patterns[idx] << ((7 - column) << 3);
+    columns |= 1 << (7 - column);
+  }
+
+  if (column > first) {
+    // Segment-major, row n now holds segment n of all digits
+    frame = _transpose(frame);
+
+    for (int seg=0; seg < 8; seg++) {
+      shift = seg << 3;
+      _displaybuffer[seg << 1] = (_displaybuffer[seg << 1] & ~columns) | (char) (frame >> shift);
+    }
+
+    // Only the changed segment bytes are sent, in one transaction
+    _updateData((QYF_NR_GRIDS * TM1638_BYTES_PER_GRID), 0);
+  }
+
+  //Update Cursor
+  _column = (column < QYF_NR_DIGITS) ? column : 0;
+
+  return column;
+}
+
+
+/** Transpose an 8x8 bit matrix, bit (8 * row) + col moves to bit (8 * col) + row
+  *
+  *  @brief Swaps 1x1, 2x2 and 4x4 blocks across the diagonal, without branches or table lookups
+  *  @param  uint64_t matrix one row per byte
+  *  @return uint64_t transposed matrix
+  */
+uint64_t TM1638_QYF::_transpose(uint64_t matrix) {
+  uint64_t t;
+
+  t = (matrix ^ (matrix >>  7)) & 0x00AA00AA00AA00AAULL;
+  matrix ^= t ^ (t <<  7);
+  t = (matrix ^ (matrix >> 14)) & 0x0000CCCC0000CCCCULL;
+  matrix ^= t ^ (t << 14);
+  t = (matrix ^ (matrix >> 28)) & 0x00000000F0F0F0F0ULL;
+  matrix ^= t ^ (t << 28);
+
+  return matrix;
+}
+
+
 /** Locate cursor to a screen column
   *
   * @param column  The horizontal position from the left, indexed from 0
@@ -565,7 +1471,7 @@ void TM1638_QYF::cls(bool clrAll) {
     }  
   }
 
-  writeData(_displaybuffer, (QYF_NR_GRIDS * TM1638_BYTES_PER_GRID));
+  _updateData((QYF_NR_GRIDS * TM1638_BYTES_PER_GRID), 0);
 
   _column = 0;   
 }     
@@ -586,7 +1492,7 @@ void TM1638_QYF::setIcon(Icon icon) {
   _displaybuffer[addr]   = _displaybuffer[addr]   | LO(icn);      
   _displaybuffer[addr+1] = _displaybuffer[addr+1] | HI(icn);      
 //  writeData(_displaybuffer, (QYF_NR_GRIDS * TM1638_BYTES_PER_GRID));
-  writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);    
+  _updateData(TM1638_BYTES_PER_GRID, addr);    
 }
 
 /** Clr Icon
@@ -605,7 +1511,7 @@ void TM1638_QYF::clrIcon(Icon icon) {
   _displaybuffer[addr]   = _displaybuffer[addr]   & ~LO(icn);      
   _displaybuffer[addr+1] = _displaybuffer[addr+1] & ~HI(icn);      
 //  writeData(_displaybuffer, (QYF_NR_GRIDS * TM1638_BYTES_PER_GRID));
-  writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);  
+  _updateData(TM1638_BYTES_PER_GRID, addr);  
 }
 
 
@@ -629,21 +1535,17 @@ void TM1638_QYF::setUDC(unsigned char udc_idx, int udc_data) {
 /** Write a single character (Stream implementation)
   */
 int TM1638_QYF::_putc(int value) {
-    bool validChar = false;
-    char pattern   = 0x00;
-    char bit       = 0x00;
+    char pattern = 0x00;
+    char bit     = 0x00;
         
     if ((value == '\n') || (value == '\r')) {
       //No character to write
-      validChar = false;
       
       //Update Cursor      
       _column = 0;
     }
     else if ((value == '.') || (value == ',')) {
       //No character to write
-      validChar = false;
-      pattern = S7_DP; // placeholder for all DPs
       
       // Check to see that DP can be shown for current column
       if (_column > 0) {
@@ -652,97 +1554,66 @@ int TM1638_QYF::_putc(int value) {
 
         _displaybuffer[14] = (_displaybuffer[14] | bit); // set bit
 
-        writeData(_displaybuffer, (QYF_NR_GRIDS * TM1638_BYTES_PER_GRID));
+        // All DPs are in the last grid
+        _updateData(TM1638_BYTES_PER_GRID, 14);
         
         //No Cursor Update
       }
     }
-    else if ((value >= 0) && (value < QYF_NR_UDC)) {
-      //Character to write
-      validChar = true;
-      pattern = _UDC_7S[value];
-    }  
-    
-#if (SHOW_ASCII == 1)
-    //display all ASCII characters
-    else if ((value >= FONT_7S_START) && (value <= FONT_7S_END)) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[value - FONT_7S_START];
-    } // else
-#else    
-    //display only digits and hex characters      
-    else if (value == '-') {
-      //Character to write
-      validChar = true;
-      pattern = C7_MIN;         
-    }
-    else if ((value >= (int)'0') && (value <= (int) '9')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[value - (int) '0'];
-    }
-    else if ((value >= (int) 'A') && (value <= (int) 'F')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[10 + value - (int) 'A'];
-    }
-    else if ((value >= (int) 'a') && (value <= (int) 'f')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[10 + value - (int) 'a'];
-    } //else
-#endif
-
-    if (validChar) {
+    else if (_getPattern(value, &pattern)) {
       //Character to write
 
       // Very annoying bitmapping :(
       // This display module uses a single byte of each grid to drive a specific segment of all digits.
       // So the bits in byte 0 (Grid 1) drive all A-segments, the bits in byte 2 (Grid 2) drive all B-segments etc.
-      // Bit0 is for the segment in Digit 8, Bit1 is for the segment in Digit 7 etc.. This bit manipulation is handled in _putc().
-      
-      bit = 1 << (7 - _column); // bitposition for the current _column
-
-      if (pattern & S7_A) {_displaybuffer[0] = (_displaybuffer[0] | bit); } // set bit
-      else                {_displaybuffer[0] = (_displaybuffer[0] & ~bit);} // clr bit       
-
-      if (pattern & S7_B) {_displaybuffer[2] = (_displaybuffer[2] | bit); } // set bit
-      else                {_displaybuffer[2] = (_displaybuffer[2] & ~bit);} // clr bit       
-
-      if (pattern & S7_C) {_displaybuffer[4] = (_displaybuffer[4] | bit); } // set bit
-      else                {_displaybuffer[4] = (_displaybuffer[4] & ~bit);} // clr bit       
-
-      if (pattern & S7_D) {_displaybuffer[6] = (_displaybuffer[6] | bit); } // set bit
-      else                {_displaybuffer[6] = (_displaybuffer[6] & ~bit);} // clr bit       
-
-      if (pattern & S7_E) {_displaybuffer[8] = (_displaybuffer[8] | bit); } // set bit
-      else                {_displaybuffer[8] = (_displaybuffer[8] & ~bit);} // clr bit       
-
-      if (pattern & S7_F) {_displaybuffer[10] = (_displaybuffer[10] | bit); } // set bit
-      else                {_displaybuffer[10] = (_displaybuffer[10] & ~bit);} // clr bit       
+      // Bit0 is for the segment in Digit 8, Bit1 is for the segment in Digit 7 etc.. The conversion is a
+      // bit matrix transpose in displayPatterns(), which also updates the cursor.
+      displayPatterns(&pattern, 1, _column);
+    }
 
-      if (pattern & S7_G) {_displaybuffer[12] = (_displaybuffer[12] | bit); } // set bit
-      else                {_displaybuffer[12] = (_displaybuffer[12] & ~bit);} // clr bit       
+    return value;
+}
 
-      if (pattern & S7_DP) {_displaybuffer[14] = (_displaybuffer[14] | bit); } // set bit
-      else                 {_displaybuffer[14] = (_displaybuffer[14] & ~bit);} // clr bit       
 
-      //Save icons...and set bits for character to write
-//      _displaybuffer[addr]   = (_displaybuffer[addr]   & MASK_ICON_GRID[_column][0]) | pattern;
-//      _displaybuffer[addr+1] = (_displaybuffer[addr+1] & MASK_ICON_GRID[_column][0]) | pattern;
+/** Look up the segment pattern of a character
+  *  @param  int value character
+  *  @param  char *pattern segment pattern
+  *  @return bool true when the character can be shown
+  */
+bool TM1638_QYF::_getPattern(int value, char *pattern) {
 
-      writeData(_displaybuffer, (QYF_NR_GRIDS * TM1638_BYTES_PER_GRID));
-                                
-      //Update Cursor
-      _column++;
-      if (_column > (QYF_NR_DIGITS - 1)) {
-        _column = 0;
-      }
+    if ((value >= 0) && (value < QYF_NR_UDC)) {
+      *pattern = _UDC_7S[value];
+      return true;
+    }
 
-    } // if validChar           
+#if (SHOW_ASCII == 1)
+    //display all ASCII characters
+    if ((value >= FONT_7S_START) && (value <= FONT_7S_END)) {
+      *pattern = FONT_7S[value - FONT_7S_START];
+      return true;
+    }
+#else
+    //display only digits and hex characters
+    if (value == '-') {
+      *pattern = C7_MIN;
+      return true;
+    }
+    if ((value >= (int) '0') && (value <= (int) '9')) {
+      *pattern = FONT_7S[value - (int) '0'];
+      return true;
+    }
+    if ((value >= (int) 'A') && (value <= (int) 'F')) {
+      *pattern = FONT_7S[10 + value - (int) 'A'];
+      return true;
+    }
+    if ((value >= (int) 'a') && (value <= (int) 'f')) {
+      *pattern = FONT_7S[10 + value - (int) 'a'];
+      return true;
+    }
+#endif
 
-    return value;
+    return false;
 }
 
 
@@ -759,6 +1630,10 @@ int TM1638_QYF::_getc() {
 // Derived class for TM1638 used in LMK1638 display unit
 //
 
+//Key map of the board
+constexpr uint8_t TM1638_LKM1638::KEY_MAP[LKM1638_NR_KEYS];
+
+#if defined(__MBED__)
 /** Constructor for class for driving TM1638 LED controller as used in LKM1638
   *
   *  @brief Supports 8 Digits of 7 Segments + DP + Bi-Color LED Icons. Also supports a scanned keyboard of 8.
@@ -768,6 +1643,19 @@ int TM1638_QYF::_getc() {
 TM1638_LKM1638::TM1638_LKM1638(PinName mosi, PinName miso, PinName sclk, PinName cs) : TM1638(mosi, miso, sclk, cs) {
   _column  = 0;
   _columns = LKM1638_NR_DIGITS;    
+  _setKeyMap(KEY_MAP, LKM1638_NR_KEYS);
+}  
+#endif
+
+/** Constructor for class for driving TM1638 LED controller as used in LKM1638 on a shared bus
+  *
+  *  @param  TM1638_Bus &bus Shared SPI bus
+  *  @param  PinName cs CS pin of this module
+  */
+TM1638_LKM1638::TM1638_LKM1638(TM1638_Bus &bus, PinName cs) : TM1638(bus, cs) {
+  _column  = 0;
+  _columns = LKM1638_NR_DIGITS;    
+  _setKeyMap(KEY_MAP, LKM1638_NR_KEYS);
 }  
 
 #if(0)
@@ -809,6 +1697,55 @@ int TM1638_LKM1638::columns() {
     return _columns;
 }
 
+
+/** Render a string to digit patterns without writing the display
+  *
+  *  @brief '.' and ',' are folded into the DP of the preceding digit, a leading or repeated DP
+  *         takes a digit of its own. Characters that can not be shown render as a blank digit.
+  *  @param  const char *str characters to render, need not be terminated
+  *  @param  int length number of characters in str
+  *  @param  char *patterns destination for one segment pattern per digit
+  *  @param  int size max number of digits in patterns
+  *  @return int number of digits rendered
+  */
+int TM1638_LKM1638::renderString(const char *str, int length, char *patterns, int size) {
+  return _renderString(str, length, patterns, size, S7_DP);
+}
+
+
+/** Display digit patterns starting at a screen column
+  *
+  *  @brief Icons are preserved and only the digits covered by the patterns are written.
+  *  @param  const char *patterns one segment pattern per digit
+  *  @param  int digits number of patterns
+  *  @param  int column start column, indexed from 0
+  *  @return int column following the last digit written
+  */
+int TM1638_LKM1638::displayPatterns(const char *patterns, int digits, int column) {
+  int first, addr;
+
+  //sanity check
+  if (column < 0) {column = 0;}
+  if (digits > (LKM1638_NR_DIGITS - column)) {digits = LKM1638_NR_DIGITS - column;}
+  first = column;
+
+  for (int idx=0; idx < digits; idx++, column++) {
+    addr = column << 1; // * TM1638_BYTES_PER_GRID
+
+    //Save icons...and set bits for character to write
+    _displaybuffer[addr] = (_displaybuffer[addr] & MASK_ICON_GRID[column][0]) | patterns[idx];
+  }
+
+  if (column > first) {
+    _updateData((column - first) * TM1638_BYTES_PER_GRID, first << 1);
+  }
+
+  //Update Cursor
+  _column = (column < LKM1638_NR_DIGITS) ? column : 0;
+
+  return column;
+}
+
     
 /** Clear the screen and locate to 0
   * @param bool clrAll Clear Icons also (default = false)
@@ -829,7 +1766,7 @@ void TM1638_LKM1638::cls(bool clrAll) {
     }  
   }
 
-  writeData(_displaybuffer, (LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID));
+  _updateData((LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID), 0);
 
   _column = 0;   
 }     
@@ -850,7 +1787,7 @@ void TM1638_LKM1638::setIcon(Icon icon) {
   _displaybuffer[addr]   = _displaybuffer[addr]   | LO(icn);      
   _displaybuffer[addr+1] = _displaybuffer[addr+1] | HI(icn);      
 //  writeData(_displaybuffer, (LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID));
-  writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);      
+  _updateData(TM1638_BYTES_PER_GRID, addr);      
 }
 
 /** Clr Icon
@@ -869,7 +1806,7 @@ void TM1638_LKM1638::clrIcon(Icon icon) {
   _displaybuffer[addr]   = _displaybuffer[addr]   & ~LO(icn);      
   _displaybuffer[addr+1] = _displaybuffer[addr+1] & ~HI(icn);      
 //  writeData(_displaybuffer, (LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID));
-  writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);      
+  _updateData(TM1638_BYTES_PER_GRID, addr);      
 }
 
 
@@ -920,47 +1857,14 @@ int TM1638_LKM1638::_putc(int value) {
 //        _displaybuffer[addr+1] = _displaybuffer[addr+1] | pattern;
 
 //        writeData(_displaybuffer, (LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID));
-        writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);    
+        _updateData(TM1638_BYTES_PER_GRID, addr);    
           
         //No Cursor Update
       }
     }
-    else if ((value >= 0) && (value < LKM1638_NR_UDC)) {
-      //Character to write
-      validChar = true;
-      pattern = _UDC_7S[value];
-    }  
-    
-#if (SHOW_ASCII == 1)
-    //display all ASCII characters
-    else if ((value >= FONT_7S_START) && (value <= FONT_7S_END)) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[value - FONT_7S_START];
-    } // else
-#else    
-    //display only digits and hex characters      
-    else if (value == '-') {
-      //Character to write
-      validChar = true;
-      pattern = C7_MIN;         
-    }
-    else if ((value >= (int)'0') && (value <= (int) '9')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[value - (int) '0'];
-    }
-    else if ((value >= (int) 'A') && (value <= (int) 'F')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[10 + value - (int) 'A'];
+    else {
+      validChar = _getPattern(value, &pattern);
     }
-    else if ((value >= (int) 'a') && (value <= (int) 'f')) {   
-      //Character to write
-      validChar = true;
-      pattern = FONT_7S[10 + value - (int) 'a'];
-    } //else
-#endif
 
     if (validChar) {
       //Character to write
@@ -973,7 +1877,7 @@ int TM1638_LKM1638::_putc(int value) {
 //      _displaybuffer[addr+1] = (_displaybuffer[addr+1] & MASK_ICON_GRID[_column][0]) | pattern;
 
 //      writeData(_displaybuffer, (LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID));
-      writeData(_displaybuffer, TM1638_BYTES_PER_GRID, addr);
+      _updateData(TM1638_BYTES_PER_GRID, addr);
       
       //Update Cursor
       _column++;
@@ -992,5 +1896,47 @@ int TM1638_LKM1638::_getc() {
     return -1;
 }
 
+
+/** Look up the segment pattern for a character
+  *  @param  int value character
+  *  @param  char *pattern segment pattern
+  *  @return bool true when the character can be shown
+  */
+bool TM1638_LKM1638::_getPattern(int value, char *pattern) {
+
+    if ((value >= 0) && (value < LKM1638_NR_UDC)) {
+      *pattern = _UDC_7S[value];
+      return true;
+    }
+
+#if (SHOW_ASCII == 1)
+    //display all ASCII characters
+    if ((value >= FONT_7S_START) && (value <= FONT_7S_END)) {
+      *pattern = FONT_7S[value - FONT_7S_START];
+      return true;
+    }
+#else
+    //display only digits and hex characters
+    if (value == '-') {
+      *pattern = C7_MIN;
+      return true;
+    }
+    if ((value >= (int) '0') && (value <= (int) '9')) {
+      *pattern = FONT_7S[value - (int) '0'];
+      return true;
+    }
+    if ((value >= (int) 'A') && (value <= (int) 'F')) {
+      *pattern = FONT_7S[10 + value - (int) 'A'];
+      return true;
+    }
+    if ((value >= (int) 'a') && (value <= (int) 'f')) {
+      *pattern = FONT_7S[10 + value - (int) 'a'];
+      return true;
+    }
+#endif
+
+    return false;
+}
+
 #endif
 
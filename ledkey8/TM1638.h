@@ -24,11 +24,17 @@
 
 #ifndef TM1638_H
 #define TM1638_H
+#if defined(__MBED__)
 #include "mbed.h"
+#else
+#include "TM1638_Host.h"
+#endif
 
 // Select one of the testboards for TM1638 LED controller
 #include "TM1638_Config.h"
 
+class TM1638_Bus;
+
 /** An interface for driving TM1638 LED controller
  *
  * @code
@@ -73,6 +79,9 @@
 #define TM1638_BYTES_PER_GRID  2
 //Significant bits Keymatrix data
 #define TM1638_KEY_MSK      0x77 
+//Significant bits of the keydata packed in one word, bit (byte index * 8) + bit
+//Each nibble is one scan line KS1..KS8, bits 0..2 are the key lines K3..K1
+#define TM1638_KEYS_MSK     0x77777777
 
 //Memory size in bytes for Display and Keymatrix
 #define TM1638_DISPLAY_MEM  (TM1638_MAX_NR_GRIDS * TM1638_BYTES_PER_GRID)
@@ -90,6 +99,8 @@
 #define TM1638_ADDR_FIXED   0x04
 #define TM1638_MODE_NORM    0x00
 #define TM1638_MODE_TEST    0x08
+#define TM1638_DATA_WR_INC    (TM1638_DATA_WR | TM1638_ADDR_INC | TM1638_MODE_NORM)
+#define TM1638_DATA_WR_FIXED  (TM1638_DATA_WR | TM1638_ADDR_FIXED | TM1638_MODE_NORM)
 
 //Address setting commands
 #define TM1638_ADDR_SET_CMD 0xC0
@@ -112,6 +123,29 @@
 #define TM1638_DSP_OFF      0x00
 #define TM1638_DSP_ON       0x08
 
+//Controller state not known (after powerup)
+#define TM1638_STATE_UNKNOWN 0xFF
+
+//Bitreversal, the TM1638 expects LSB first whereas SPI is MSB first
+#define TM1638_REV8(x)   ((char) ((((x) & 0x01) << 7) | (((x) & 0x02) << 5) | (((x) & 0x04) << 3) | (((x) & 0x08) << 1) | \
+                                  (((x) & 0x10) >> 1) | (((x) & 0x20) >> 3) | (((x) & 0x40) >> 5) | (((x) & 0x80) >> 7)))
+
+//Commands in wire order (bitreversed at compile time)
+#define TM1638_DATA_WR_CMD_W  TM1638_REV8(TM1638_DATA_SET_CMD | TM1638_DATA_WR | TM1638_ADDR_INC | TM1638_MODE_NORM)
+#define TM1638_KEY_RD_CMD_W   TM1638_REV8(TM1638_DATA_SET_CMD | TM1638_KEY_RD | TM1638_ADDR_INC | TM1638_MODE_NORM)
+#define TM1638_ADDR_SET_CMD_W TM1638_REV8(TM1638_ADDR_SET_CMD)
+#define TM1638_DSP_CTRL_CMD_W TM1638_REV8(TM1638_DSP_CTRL_CMD)
+
+//Lookup table for runtime bitreversal on cores without an RBIT instruction
+extern const char TM1638_FLIP[256];
+
+//Diff-only display writes
+//Bus cost of opening a CS window in byte times (CS setup/hold and call overhead at 500 kHz)
+#define TM1638_CS_COST      1
+//Unchanged bytes between two dirty ranges are resent when the gap is at most this size,
+//since bridging a short gap in one auto-increment burst is cheaper than a new CS window + address command
+#define TM1638_MERGE_GAP    (TM1638_CS_COST)
+
 
 /** A class for driving TM1638 LED controller
  *
@@ -126,7 +160,22 @@ class TM1638 {
   
   /** Datatypes for keymatrix data */
   typedef char KeyData_t[TM1638_KEY_MEM];
+
+  /** Datatype for display write statistics */
+  typedef struct {
+    uint32_t flushes;    /**< Number of display writes requested */
+    uint32_t requested;  /**< Display bytes requested by the callers */
+    uint32_t sent;       /**< Display bytes actually sent, including bridged gaps */
+    uint32_t saved;      /**< Display bytes skipped because the controller already held them */
+    uint32_t bursts;     /**< Number of address set + data bursts */
+    uint32_t lastSaved;  /**< Display bytes skipped by the most recent write */
+    uint32_t incWrites;  /**< Writes sent as auto-increment bursts */
+    uint32_t fixedWrites;/**< Writes sent as fixed address single bytes */
+    uint32_t cmdsSent;   /**< Data set and display control commands sent */
+    uint32_t cmdsSkipped;/**< Data set and display control commands skipped, controller already in that state */
+  } FlushStats_t;
     
+#if defined(__MBED__)
  /** Constructor for class for driving TM1638 LED controller
   *
   * @brief Supports 8 Grids @ 10 segments. 
@@ -136,36 +185,189 @@ class TM1638 {
   *  @param  PinName mosi, miso, sclk, cs SPI bus pins
   */
   TM1638(PinName mosi, PinName miso, PinName sclk, PinName cs);
+#endif
+
+ /** Constructor for class for driving TM1638 LED controller on a shared bus
+  *
+  *  @param  TM1638_Bus &bus Shared SPI bus
+  *  @param  PinName cs CS pin of this module
+  */
+  TM1638(TM1638_Bus &bus, PinName cs);
+
+  /** Destructor for class for driving TM1638 LED controller
+   */
+  virtual ~TM1638();
  
   /** Clear the screen and locate to 0
    */ 
   void cls();  
 
+  /** Number of screen columns, the boards with digits override this
+   *  @param  none
+   *  @return int columns, 0 for a controller without digits
+   */
+  virtual int columns();
+
+  /** Render a string to digit patterns without writing the display, the boards with digits override this
+   *  @param  const char *str characters to render, need not be terminated
+   *  @param  int length number of characters in str
+   *  @param  char *patterns destination for one segment pattern per digit
+   *  @param  int size max number of digits in patterns
+   *  @return int number of digits rendered, 0 for a controller without digits
+   */
+  virtual int renderString(const char *str, int length, char *patterns, int size);
+
+  /** Display digit patterns starting at a screen column, the boards with digits override this
+   *  @param  const char *patterns one segment pattern per digit, eg from renderString()
+   *  @param  int digits number of patterns
+   *  @param  int column start column, indexed from 0
+   *  @return int column following the last digit written
+   */
+  virtual int displayPatterns(const char *patterns, int digits, int column = 0);
+
   /** Write databyte to TM1638
    *  @param  char data byte written at given address
    *  @param  int address display memory location to write byte
-   *  @return none
+   *  @return int number of bytes saved (1 when the controller already holds this byte)
    */ 
-   void writeData(char data, int address); 
+   int writeData(char data, int address); 
 
    /** Write Display datablock to TM1638
     *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for displaydata
     *  @param  length number bytes to write (valid range 0..(TM1638_MAX_NR_GRIDS * TM1638_BYTES_PER_GRID) (=16), when starting at address 0)  
     *  @param  int address display memory location to write bytes (default = 0) 
-    *  @return none
+    *  @return int number of bytes saved compared to writing the full block
+    *
+    * Note: Only the bytes that differ from the shadow copy of the controller memory are sent.
+    *       Nearby dirty ranges are merged into one auto-increment burst (see TM1638_MERGE_GAP).
+    *       The bus cost of auto-increment bursts and fixed address single byte writes is compared
+    *       and the cheaper address mode is used (see FlushStats_t incWrites and fixedWrites).
+    *       With split ranges a one byte burst costs the same as a fixed address write, the fixed mode
+    *       pays off for sparse changes sent by commit() or present(), which merge all changes into one span.
     */ 
-    void writeData(DisplayData_t data, int length = (TM1638_MAX_NR_GRIDS * TM1638_BYTES_PER_GRID), int address = 0);
+    int writeData(const DisplayData_t data, int length = (TM1638_MAX_NR_GRIDS * TM1638_BYTES_PER_GRID), int address = 0);
+
+  /** Start a batch of display updates
+   *  @param  none
+   *  @return none
+   *
+   * Note: Changes to the local displaybuffer (e.g. putc, setIcon, clrIcon, cls) are not sent until the
+   *       matching commit(). Batches may be nested, the outermost commit() sends the changes.
+   */
+  void beginUpdate();
+
+  /** End a batch of display updates, all changes are sent to TM1638 as one auto-increment burst
+   *  @param  none
+   *  @return none
+   */
+  void commit();
+
+  /** Start drawing a frame in the back buffer
+   *  @param  none
+   *  @return none
+   *
+   * Note: Drawing calls (e.g. putc, setIcon, clrIcon, cls) only change the local displaybuffer, which is the back buffer,
+   *       and cause no bus traffic. Other producers wait in beginFrame() until this frame is presented.
+   *       Frames may be nested, the outermost present() sends the frame. Independent of beginUpdate()/commit().
+   */
+  void beginFrame();
+
+  /** Present the frame drawn since beginFrame(), only the differences with the controller memory are sent
+   *  @param  none
+   *  @return none
+   *
+   * Note: The completed back buffer becomes the front frame at once, the controller never shows part of a frame.
+   *       When another thread is still sending an earlier frame, present() returns without bus access
+   *       and that thread sends the latest front frame next, so concurrent presents collapse into one write.
+   *       Without beginFrame() the local displaybuffer is presented as is, after a frame drawn by another thread.
+   */
+  void present();
+
+  /** Keep display changes in the local displaybuffer until flush() is called
+   *  @param  bool deferred (e.g. when TM1638_Bus::service() schedules the flushes)
+   *  @return none
+   *
+   * Note: Drawing calls, commit() and present() send nothing while deferred.
+   */
+  void setDeferred(bool deferred) { _deferred = deferred; }
+
+  /** Send all changes in the local displaybuffer that the controller does not hold yet
+   *  @param  none
+   *  @return none
+   */
+  void flush();
+
+  /** Local copy of the display memory as drawn by putc, setIcon, cls etc
+   *  @return const char* Array of TM1638_DISPLAY_MEM (=16) bytes
+   */
+  const char *getDisplayBuffer() const { return _displaybuffer; }
+
+  /** Copy the local displaybuffer, or the front frame while a frame is drawn
+   *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for the copy
+   *  @return none
+   *
+   * Note: Does not wait for the frame that is drawn, a half drawn frame is never copied.
+   */
+  void copyDisplayBuffer(DisplayData_t data);
+
+  /** Forget the shadow copy of the controller memory, the next write will send all requested bytes
+   *  @param  none
+   *  @return none
+   */
+  void invalidate();
+
+  /** Get the display write statistics
+   *  @return const FlushStats_t& statistics since start or last reset
+   */
+  const FlushStats_t& getFlushStats() const { return _stats; }
+
+  /** Reset the display write statistics
+   */
+  void resetFlushStats();
  
   /** Read keydata block from TM1638
    *  @param  *keydata Ptr to Array of TM1638_KEY_MEM (=4) bytes for keydata
-   *  @return bool keypress True when at least one key was pressed
+   *  @return bool keypress True when at least one key is held for sure
    *
    * Note: Due to the hardware configuration the TM1638 key matrix scanner will detect multiple keys pressed at same time,
    *       but this may result in some spurious keys also being set in keypress data array.
-   *       It may be best to ignore all keys in those situations. That option is implemented in this method depending on #define setting.
+   *       The keydata holds all keys as read, use the method below to separate held keys from possible ghosts.
    */   
   bool getKeys(KeyData_t *keydata);
 
+  /** Read the keys from TM1638 and decode chords
+   *  @param  uint32_t *held keys of this board that are pressed for sure, bit 0 is SW1
+   *  @param  uint32_t *ambiguous keys of this board that are pressed or may be a ghost of a chord (optional)
+   *  @return bool keypress True when at least one key is held for sure
+   *
+   * Note: The key state is in logical key order of the board (see the Key enums of the derived classes),
+   *       so callers can use popcount, ctz and (previous ^ current) directly.
+   *       Without a board key map the bits are in packed keydata order, bit (byte index * 8) + bit.
+   */   
+  bool getKeys(uint32_t *held, uint32_t *ambiguous = NULL);
+
+  /** Convert packed keydata to the logical key order of the board
+   *  @param  uint32_t keys packed keydata, bit (byte index * 8) + bit
+   *  @return uint32_t key state, bit 0 is SW1
+   */   
+  uint32_t mapKeys(uint32_t keys) const;
+
+  /** Number of keys on the board
+   *  @return int keys
+   */   
+  int getNrKeys() const { return _nrKeys; }
+
+  /** Separate held keys from possible ghost keys in packed keydata
+   *  @param  uint32_t keys packed keydata as read, bit (byte index * 8) + bit
+   *  @param  uint32_t *ambiguous keys that are pressed or may be a ghost (optional)
+   *  @return uint32_t keys that are pressed for sure
+   *
+   * Note: The key matrix has no diodes. When three corners of a rectangle of scan lines and key lines are pressed,
+   *       the fourth corner reads as pressed too. Any key on such a rectangle may be the ghost,
+   *       all other keys are certain. Boards with all keys on one key line (LEDKEY8, LKM1638) never have ghosts.
+   */   
+  static uint32_t decodeKeys(uint32_t keys, uint32_t *ambiguous = NULL);
+
   /** Set Brightness
     *
     * @param  char brightness (3 significant bits, valid range 0..7 (1/16 .. 14/16 dutycycle)  
@@ -178,24 +380,146 @@ class TM1638 {
     * @param bool display mode
     */
   void setDisplay(bool on);
+
+  /** Set the Display mode On/off and the Brightness with one display control cmd
+    *
+    * @param  bool on display mode
+    * @param  char brightness (3 significant bits, valid range 0..7 (1/16 .. 14/16 dutycycle)
+    * @return none
+    *
+    * Note: No cmd is sent when the controller is already in this state.
+    */
+  void setDisplay(bool on, char brightness);
+
+#if DEVICE_SPI_ASYNCH
+  /** Write Display datablock to TM1638 without blocking the caller
+   *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for displaydata
+   *  @param  done Callback invoked with the SPI event when the burst has been sent (optional)
+   *  @param  length number bytes to write (valid range 0..TM1638_DISPLAY_MEM (=16), when starting at address 0)
+   *  @param  int address display memory location to write bytes (default = 0)
+   *  @return bool true when the burst was queued (or nothing had changed), false when a previous burst is still busy
+   *
+   * Note: The changed bytes are sent as a single auto-increment burst from a prebuilt wire buffer using the
+   *       asynchronous SPI API. The blocking methods wait for a pending burst before they use the bus.
+   *       done is called from interrupt context when the burst completes. When nothing had changed, or the bus
+   *       has no asynchronous transfers (eg TM1638_GPIOBus), done is called in the caller's thread before
+   *       writeDataAsync() returns. A callback must therefore be safe in both contexts.
+   */
+  bool writeDataAsync(const DisplayData_t data, const event_callback_t &done = nullptr, int length = TM1638_DISPLAY_MEM, int address = 0);
+
+  /** Check for a pending asynchronous burst on the bus
+   *  @return bool busy
+   */
+  bool isBusy() const;
+#endif
   
+ protected:
+  // Local copy of the display memory as drawn by the derived classes
+  DisplayData_t _displaybuffer;
+
+  /** Write a range of the local displaybuffer, unless a batch of updates is in progress
+    *  @param  int length number of bytes to write
+    *  @param  int address display memory location to write bytes
+    *  @return none
+    */
+  void _updateData(int length, int address);
+
+  // Keys fitted on the board as packed keydata, and their logical order
+  uint32_t _keyMask;
+  const uint8_t *_keyMap;
+  int _nrKeys;
+
+  /** Set the key map of the board
+    *  @param  const uint8_t *map packed keydata bit of each key, SW1 first
+    *  @param  int keys number of keys
+    *  @return none
+    */
+  void _setKeyMap(const uint8_t *map, int keys);
+
+  /** Render a string to digit patterns, shared by the renderString() of the boards
+    *  @param  const char *str characters to render, need not be terminated
+    *  @param  int length number of characters in str
+    *  @param  char *patterns destination for one segment pattern per digit
+    *  @param  int size max number of digits in patterns
+    *  @param  char dp segment pattern of the decimal point
+    *  @return int number of digits rendered
+    */
+  int _renderString(const char *str, int length, char *patterns, int size, char dp);
+
+  /** Look up the segment pattern for a character, the boards with a font override this
+    *  @param  int value character
+    *  @param  char *pattern segment pattern
+    *  @return bool true when the character can be shown
+    */
+  virtual bool _getPattern(int value, char *pattern);
+
  private:  
-  SPI _spi;
-  DigitalOut _cs;
+  TM1638_Bus *_bus;
+  int _slot;
+  bool _ownBus;
   char _display;
   char _bright; 
+
+#if DEVICE_SPI_ASYNCH
+  // Wire buffer for asynchronous bursts: address set cmd followed by bitreversed data
+  char _txbuf[1 + TM1638_DISPLAY_MEM];
+
+#if (TM1638_LATENCY == 1)
+  // Callback of the burst in flight, _asyncComplete() stamps the completion before calling it
+  event_callback_t _asyncDone;
+
+  /** Completion of an asynchronous burst, closes the latency measurement
+    *  @param  int event SPI event
+    *  @return none
+    */
+  void _asyncComplete(int event);
+#endif
+#endif
+
+  // Shadow copy of the controller display memory, bits in _shadowValid flag known bytes
+  char _shadow[TM1638_DISPLAY_MEM];
+  uint16_t _shadowValid;
+  FlushStats_t _stats;
+  int _updateDepth;
+  bool _deferred;
+
+  // Front frame as last presented, the producer that presents and the thread that sends it
+  // _frameDepth counts the open beginFrame() calls of the thread that holds _frameMutex,
+  // only that thread changes it, other threads read it atomically
+  volatile uint32_t _frameDepth;
+
+  /** A frame is drawn in the back buffer
+    *  @return bool frame open
+    */
+  bool _inFrame() const { return (core_util_atomic_load_u32(&_frameDepth) != 0); }
+  DisplayData_t _frontbuffer;
+  PlatformMutex _frameMutex;
+  PlatformMutex _frontMutex;
+  bool _presentPending;
+  bool _presenting;
+
+  // Controller state as last sent, TM1638_STATE_UNKNOWN forces the next command
+  char _dataSet;
+  char _dspCtrl;
   
-  /** Init the SPI interface and the controller
+  /** Init the controller
     * @param  none
     * @return none
     */ 
   void _init();
 
   /** Helper to reverse all command or databits. The TM1638 expects LSB first, whereas SPI is MSB first
+    *  Uses the RBIT instruction on Thumb-2 cores, or a lookup table otherwise.
     *  @param  char data
     *  @return bitreversed data
     */ 
-  char _flip(char data);
+  static char _flip(char data) {
+#if defined(__ARM_ARCH_ISA_THUMB) && (__ARM_ARCH_ISA_THUMB >= 2)
+    return (char) (__RBIT((uint32_t) data) >> 24);
+#else
+    return TM1638_FLIP[(unsigned char) data];
+#endif
+  }
 
   /** Write command and parameter to TM1638
     *  @param  int cmd Command byte
@@ -203,6 +527,51 @@ class TM1638 {
     *  @return none
     */ 
   void _writeCmd(int cmd, int data);  
+
+  /** Helper to test whether the controller holds a different value at this address
+    *  @param  int address display memory location
+    *  @param  char data new value
+    *  @return bool dirty
+    */
+  bool _isDirty(int address, char data) const {
+    return (!(_shadowValid & (1 << address)) || (_shadow[address] != data));
+  }
+
+  /** Write one auto-increment burst of display data and update the shadow copy
+    *  @param  const char *data Array of display data, indexed by address
+    *  @param  int address first display memory location
+    *  @param  int length number of bytes to write
+    *  @return none
+    */
+  void _writeBurst(const char *data, int address, int length);
+
+  /** Write the changed bytes of a display datablock to TM1638
+    *  @param  const char *data Array of display data, indexed by address
+    *  @param  int length number bytes to write
+    *  @param  int address display memory location to write bytes
+    *  @param  int maxgap largest number of unchanged bytes bridged within one burst
+    *  @return int number of bytes saved compared to writing the full block
+    */
+  int _flush(const char *data, int length, int address, int maxgap);
+
+  /** Select the address mode for display writes, the data set cmd is only sent when the mode changes
+    *  @param  char mode TM1638_ADDR_INC or TM1638_ADDR_FIXED
+    *  @return none
+    */
+  void _setAddrMode(char mode);
+
+  /** Send the display control cmd when display on/off or brightness has changed
+    *  @param  none
+    *  @return none
+    */
+  void _setDspCtrl();
+
+  /** Read keydata block from TM1638
+    *  @param  *keydata Ptr to Array of TM1638_KEY_MEM (=4) bytes for keydata, masked with TM1638_KEY_MSK
+    *  @return uint32_t packed keydata, bit (byte index * 8) + bit
+    */
+  uint32_t _readKeys(KeyData_t *keydata);
+
 };
 
 
@@ -215,25 +584,7 @@ class TM1638 {
 #define LEDKEY8_NR_GRIDS  8
 #define LEDKEY8_NR_DIGITS 8
 #define LEDKEY8_NR_UDC    8
-
-//Access to 8 Switches
-#define LEDKEY8_SW1_IDX   0
-#define LEDKEY8_SW1_BIT   0x01
-#define LEDKEY8_SW2_IDX   1
-#define LEDKEY8_SW2_BIT   0x01
-#define LEDKEY8_SW3_IDX   2
-#define LEDKEY8_SW3_BIT   0x01
-#define LEDKEY8_SW4_IDX   3
-#define LEDKEY8_SW4_BIT   0x01
-
-#define LEDKEY8_SW5_IDX   0
-#define LEDKEY8_SW5_BIT   0x10
-#define LEDKEY8_SW6_IDX   1
-#define LEDKEY8_SW6_BIT   0x10
-#define LEDKEY8_SW7_IDX   2
-#define LEDKEY8_SW7_BIT   0x10
-#define LEDKEY8_SW8_IDX   3
-#define LEDKEY8_SW8_BIT   0x10
+#define LEDKEY8_NR_KEYS   8
 
 /** Constructor for class for driving TM1638 controller as used in LEDKEY8
   *
@@ -265,9 +616,28 @@ class TM1638_LEDKEY8 : public TM1638 {
     DP7  = (7<<24) | S7_DP7, /**<  Decimal Point 7 */
     DP8  = (8<<24) | S7_DP8  /**<  Decimal Point 8 */  
   };
+
+  /** Enums for Keys, bits of the key state returned by getKeys() */
+  enum Key {
+    SW1  = (1<<0), /**<  Switch 1 */
+    SW2  = (1<<1), /**<  Switch 2 */
+    SW3  = (1<<2), /**<  Switch 3 */
+    SW4  = (1<<3), /**<  Switch 4 */
+    SW5  = (1<<4), /**<  Switch 5 */
+    SW6  = (1<<5), /**<  Switch 6 */
+    SW7  = (1<<6), /**<  Switch 7 */
+    SW8  = (1<<7)  /**<  Switch 8 */
+  };
+
+  /** Packed keydata bit of the keys SW1..SW8, (byte index * 8) + bit */
+  static constexpr uint8_t KEY_MAP[LEDKEY8_NR_KEYS] = {
+     0,  8, 16, 24,  // SW1..SW4 on K3, KS1 KS3 KS5 KS7
+     4, 12, 20, 28   // SW5..SW8 on K3, KS2 KS4 KS6 KS8
+  };
   
   typedef char UDCData_t[LEDKEY8_NR_UDC];
   
+#if defined(__MBED__)
  /** Constructor for class for driving TM1638 LED controller as used in LEDKEY8
    *
    * @brief Supports 8 Digits of 7 Segments + DP + LED Icons. Also supports a scanned keyboard of 8 keys.
@@ -275,6 +645,14 @@ class TM1638_LEDKEY8 : public TM1638 {
    * @param  PinName mosi, miso, sclk, cs SPI bus pins
    */
   TM1638_LEDKEY8(PinName mosi, PinName miso, PinName sclk, PinName cs);
+#endif
+
+ /** Constructor for class for driving TM1638 LED controller as used in LEDKEY8 on a shared bus
+   *
+   * @param  TM1638_Bus &bus Shared SPI bus
+   * @param  PinName cs CS pin of this module
+   */
+  TM1638_LEDKEY8(TM1638_Bus &bus, PinName cs);
 
 #if DOXYGEN_ONLY
     /** Write a character to the Display
@@ -291,11 +669,47 @@ class TM1638_LEDKEY8 : public TM1638 {
     int printf(const char* format, ...);   
 #endif
 
-/* Display a tring in ascii to the 8 digit seven segment display 
- * TODO start the string at the locate column
- *
- */
- void displayStringAt(char *inString, int column) ;
+    /** Display a string starting at a screen column
+     *
+     *  @brief Characters are laid out directly into the displaybuffer, '.' and ',' are shown as the DP
+     *         of the preceding digit. Icons are preserved and only the digits covered by the string are written.
+     *         Characters that can not be shown leave a blank digit.
+     *  @param  const char *str characters to display, need not be terminated
+     *  @param  int length number of characters in str
+     *  @param  int column start column, indexed from 0
+     *  @return int column following the last digit written
+     */
+    int displayStringAt(const char *str, int length, int column);
+
+    /** Display a zero terminated string starting at a screen column
+     *
+     *  @param  const char *str zero terminated string to display
+     *  @param  int column start column, indexed from 0
+     *  @return int column following the last digit written
+     */
+    int displayStringAt(const char *str, int column);
+
+    /** Render a string to digit patterns without writing the display
+     *
+     *  @brief '.' and ',' are folded into the DP of the preceding digit, a leading or repeated DP
+     *         takes a digit of its own. Characters that can not be shown render as a blank digit.
+     *  @param  const char *str characters to render, need not be terminated
+     *  @param  int length number of characters in str
+     *  @param  char *patterns destination for one segment pattern per digit
+     *  @param  int size max number of digits in patterns
+     *  @return int number of digits rendered
+     */
+    int renderString(const char *str, int length, char *patterns, int size);
+
+    /** Display digit patterns starting at a screen column
+     *
+     *  @brief Icons are preserved and only the digits covered by the patterns are written.
+     *  @param  const char *patterns one segment pattern per digit, eg from renderString()
+     *  @param  int digits number of patterns
+     *  @param  int column start column, indexed from 0
+     *  @return int column following the last digit written
+     */
+    int displayPatterns(const char *patterns, int digits, int column = 0);
 
      /** Locate cursor to a screen column
      *
@@ -340,20 +754,20 @@ class TM1638_LEDKEY8 : public TM1638 {
    /** Write databyte to TM1638
      *  @param  char data byte written at given address
      *  @param  int address display memory location to write byte
-     *  @return none
+     *  @return int number of bytes saved
      */ 
-    void writeData(char data, int address){
-      TM1638::writeData(data, address);
+    int writeData(char data, int address){
+      return TM1638::writeData(data, address);
     }        
 
    /** Write Display datablock to TM1638
     *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for displaydata
     *  @param  length number bytes to write (valid range 0..(LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID) (=16), when starting at address 0)  
     *  @param  int address display memory location to write bytes (default = 0) 
-    *  @return none
+    *  @return int number of bytes saved
     */   
-    void writeData(DisplayData_t data, int length = (LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID), int address = 0) {
-      TM1638::writeData(data, length, address);
+    int writeData(const DisplayData_t data, int length = (LEDKEY8_NR_GRIDS * TM1638_BYTES_PER_GRID), int address = 0) {
+      return TM1638::writeData(data, length, address);
     }  
 
 protected:  
@@ -365,8 +779,14 @@ private:
     int _column;
     int _columns;   
     
-    DisplayData_t _displaybuffer;
     UDCData_t _UDC_7S; 
+
+   /** Look up the segment pattern for a character
+     *  @param  int value character
+     *  @param  char *pattern segment pattern
+     *  @return bool true when the character can be shown
+     */
+    virtual bool _getPattern(int value, char *pattern);
 };
 #endif
 
@@ -380,43 +800,7 @@ private:
 #define QYF_NR_GRIDS  8
 #define QYF_NR_DIGITS 8
 #define QYF_NR_UDC    8
-
-//Access to 16 Switches
-#define QYF_SW1_IDX   0
-#define QYF_SW1_BIT   0x04
-#define QYF_SW2_IDX   0
-#define QYF_SW2_BIT   0x40
-#define QYF_SW3_IDX   1
-#define QYF_SW3_BIT   0x04
-#define QYF_SW4_IDX   1
-#define QYF_SW4_BIT   0x40
-
-#define QYF_SW5_IDX   2
-#define QYF_SW5_BIT   0x04
-#define QYF_SW6_IDX   2
-#define QYF_SW6_BIT   0x40
-#define QYF_SW7_IDX   3
-#define QYF_SW7_BIT   0x04
-#define QYF_SW8_IDX   3
-#define QYF_SW8_BIT   0x40
-
-#define QYF_SW9_IDX    0
-#define QYF_SW9_BIT    0x02
-#define QYF_SW10_IDX   0
-#define QYF_SW10_BIT   0x20
-#define QYF_SW11_IDX   1
-#define QYF_SW11_BIT   0x02
-#define QYF_SW12_IDX   1
-#define QYF_SW12_BIT   0x20
-
-#define QYF_SW13_IDX   2
-#define QYF_SW13_BIT   0x02
-#define QYF_SW14_IDX   2
-#define QYF_SW14_BIT   0x20
-#define QYF_SW15_IDX   3
-#define QYF_SW15_BIT   0x02
-#define QYF_SW16_IDX   3
-#define QYF_SW16_BIT   0x20
+#define QYF_NR_KEYS   16
 
 /** Constructor for class for driving TM1638 controller as used in QYF
   *
@@ -439,9 +823,36 @@ class TM1638_QYF : public TM1638, public Stream {
     DP7  = (8<<24) | S7_DP7, /**<  Decimal Point 7 */
     DP8  = (8<<24) | S7_DP8  /**<  Decimal Point 8 */  
   };
+
+  /** Enums for Keys, bits of the key state returned by getKeys() */
+  enum Key {
+    SW1  = (1<<0),  /**<  Switch 1 */
+    SW2  = (1<<1),  /**<  Switch 2 */
+    SW3  = (1<<2),  /**<  Switch 3 */
+    SW4  = (1<<3),  /**<  Switch 4 */
+    SW5  = (1<<4),  /**<  Switch 5 */
+    SW6  = (1<<5),  /**<  Switch 6 */
+    SW7  = (1<<6),  /**<  Switch 7 */
+    SW8  = (1<<7),  /**<  Switch 8 */
+    SW9  = (1<<8),  /**<  Switch 9 */
+    SW10 = (1<<9),  /**<  Switch 10 */
+    SW11 = (1<<10), /**<  Switch 11 */
+    SW12 = (1<<11), /**<  Switch 12 */
+    SW13 = (1<<12), /**<  Switch 13 */
+    SW14 = (1<<13), /**<  Switch 14 */
+    SW15 = (1<<14), /**<  Switch 15 */
+    SW16 = (1<<15)  /**<  Switch 16 */
+  };
+
+  /** Packed keydata bit of the keys SW1..SW16, (byte index * 8) + bit */
+  static constexpr uint8_t KEY_MAP[QYF_NR_KEYS] = {
+     2,  6, 10, 14, 18, 22, 26, 30,  // SW1..SW8 on K1, KS1..KS8
+     1,  5,  9, 13, 17, 21, 25, 29   // SW9..SW16 on K2, KS1..KS8
+  };
   
   typedef char UDCData_t[QYF_NR_UDC];
   
+#if defined(__MBED__)
  /** Constructor for class for driving TM1638 LED controller as used in QYF
    *
    * @brief Supports 8 Digits of 7 Segments + DP Icons. Also supports a scanned keyboard of 16 keys.
@@ -449,6 +860,14 @@ class TM1638_QYF : public TM1638, public Stream {
    * @param  PinName mosi, miso, sclk, cs SPI bus pins
    */
   TM1638_QYF(PinName mosi, PinName miso, PinName sclk, PinName cs);
+#endif
+
+ /** Constructor for class for driving TM1638 LED controller as used in QYF on a shared bus
+   *
+   * @param  TM1638_Bus &bus Shared SPI bus
+   * @param  PinName cs CS pin of this module
+   */
+  TM1638_QYF(TM1638_Bus &bus, PinName cs);
 
 #if DOXYGEN_ONLY
     /** Write a character to the Display
@@ -465,6 +884,49 @@ class TM1638_QYF : public TM1638, public Stream {
     int printf(const char* format, ...);   
 #endif
 
+    /** Display a string starting at a screen column
+     *
+     *  @brief The whole string is rendered to digit patterns first and converted to the segment-major
+     *         layout of this module in one step, the display is written once. '.' and ',' are shown as
+     *         the DP of the preceding digit. Characters that can not be shown leave a blank digit.
+     *  @param  const char *str characters to display, need not be terminated
+     *  @param  int length number of characters in str
+     *  @param  int column start column, indexed from 0
+     *  @return int column following the last digit written
+     */
+    int displayStringAt(const char *str, int length, int column);
+
+    /** Display a zero terminated string starting at a screen column
+     *
+     *  @param  const char *str zero terminated string to display
+     *  @param  int column start column, indexed from 0
+     *  @return int column following the last digit written
+     */
+    int displayStringAt(const char *str, int column);
+
+    /** Render a string to digit patterns without writing the display
+     *
+     *  @brief '.' and ',' are folded into the DP of the preceding digit, a leading or repeated DP
+     *         takes a digit of its own. Characters that can not be shown render as a blank digit.
+     *  @param  const char *str characters to render, need not be terminated
+     *  @param  int length number of characters in str
+     *  @param  char *patterns destination for one segment pattern per digit
+     *  @param  int size max number of digits in patterns
+     *  @return int number of digits rendered
+     */
+    int renderString(const char *str, int length, char *patterns, int size);
+
+    /** Display digit patterns starting at a screen column
+     *
+     *  @brief Only the digits covered by the patterns are written. The patterns are transposed
+     *         to the segment-major layout in one step.
+     *  @param  const char *patterns one segment pattern per digit, eg from renderString()
+     *  @param  int digits number of patterns
+     *  @param  int column start column, indexed from 0
+     *  @return int column following the last digit written
+     */
+    int displayPatterns(const char *patterns, int digits, int column = 0);
+
      /** Locate cursor to a screen column
      *
      * @param column  The horizontal position from the left, indexed from 0
@@ -508,20 +970,20 @@ class TM1638_QYF : public TM1638, public Stream {
    /** Write databyte to TM1638
      *  @param  char data byte written at given address   
      *  @param  int address display memory location to write byte
-     *  @return none
+     *  @return int number of bytes saved
      */ 
-    void writeData(char data, int address){
-      TM1638::writeData(data, address);
+    int writeData(char data, int address){
+      return TM1638::writeData(data, address);
     }        
 
    /** Write Display datablock to TM1638
     *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for displaydata
     *  @param  length number bytes to write (valid range 0..(QYF_NR_GRIDS * TM1638_BYTES_PER_GRID) (=16), when starting at address 0)  
     *  @param  int address display memory location to write bytes (default = 0) 
-    *  @return none
+    *  @return int number of bytes saved
     */   
-    void writeData(DisplayData_t data, int length = (QYF_NR_GRIDS * TM1638_BYTES_PER_GRID), int address = 0) {
-      TM1638::writeData(data, length, address);
+    int writeData(const DisplayData_t data, int length = (QYF_NR_GRIDS * TM1638_BYTES_PER_GRID), int address = 0) {
+      return TM1638::writeData(data, length, address);
     }  
 
 protected:  
@@ -533,8 +995,20 @@ private:
     int _column;
     int _columns;   
     
-    DisplayData_t _displaybuffer;
     UDCData_t _UDC_7S; 
+
+   /** Look up the segment pattern of a character
+     *  @param  int value character
+     *  @param  char *pattern segment pattern
+     *  @return bool true when the character can be shown
+     */
+    virtual bool _getPattern(int value, char *pattern);
+
+   /** Transpose an 8x8 bit matrix, bit (8 * row) + col moves to bit (8 * col) + row
+     *  @param  uint64_t matrix one row per byte
+     *  @return uint64_t transposed matrix
+     */
+    static uint64_t _transpose(uint64_t matrix);
 };
 #endif
 
@@ -547,25 +1021,7 @@ private:
 #define LKM1638_NR_GRIDS  8
 #define LKM1638_NR_DIGITS 8
 #define LKM1638_NR_UDC    8
-
-//Access to 8 Switches
-#define LKM1638_SW1_IDX   0
-#define LKM1638_SW1_BIT   0x01
-#define LKM1638_SW2_IDX   1
-#define LKM1638_SW2_BIT   0x01
-#define LKM1638_SW3_IDX   2
-#define LKM1638_SW3_BIT   0x01
-#define LKM1638_SW4_IDX   3
-#define LKM1638_SW4_BIT   0x01
-
-#define LKM1638_SW5_IDX   0
-#define LKM1638_SW5_BIT   0x10
-#define LKM1638_SW6_IDX   1
-#define LKM1638_SW6_BIT   0x10
-#define LKM1638_SW7_IDX   2
-#define LKM1638_SW7_BIT   0x10
-#define LKM1638_SW8_IDX   3
-#define LKM1638_SW8_BIT   0x10
+#define LKM1638_NR_KEYS   8
 
 /** Constructor for class for driving TM1638 controller as used in LKM1638
   *
@@ -615,9 +1071,28 @@ class TM1638_LKM1638 : public TM1638, public Stream {
     YL7  = (7<<24) | S7_YL7, /**<  Yellow LED 7 */
     YL8  = (8<<24) | S7_YL8  /**<  Yellow LED 8 */  
   };
+
+  /** Enums for Keys, bits of the key state returned by getKeys() */
+  enum Key {
+    SW1  = (1<<0), /**<  Switch 1 */
+    SW2  = (1<<1), /**<  Switch 2 */
+    SW3  = (1<<2), /**<  Switch 3 */
+    SW4  = (1<<3), /**<  Switch 4 */
+    SW5  = (1<<4), /**<  Switch 5 */
+    SW6  = (1<<5), /**<  Switch 6 */
+    SW7  = (1<<6), /**<  Switch 7 */
+    SW8  = (1<<7)  /**<  Switch 8 */
+  };
+
+  /** Packed keydata bit of the keys SW1..SW8, (byte index * 8) + bit */
+  static constexpr uint8_t KEY_MAP[LKM1638_NR_KEYS] = {
+     0,  8, 16, 24,  // SW1..SW4 on K3, KS1 KS3 KS5 KS7
+     4, 12, 20, 28   // SW5..SW8 on K3, KS2 KS4 KS6 KS8
+  };
   
   typedef char UDCData_t[LKM1638_NR_UDC];
   
+#if defined(__MBED__)
  /** Constructor for class for driving TM1638 LED controller as used in LKM1638
    *
    * @brief Supports 8 Digits of 7 Segments + DP Icons. Also supports 8 Bi-Color LEDs and a scanned keyboard of 8 keys.
@@ -625,6 +1100,14 @@ class TM1638_LKM1638 : public TM1638, public Stream {
    * @param  PinName mosi, miso, sclk, cs SPI bus pins
    */
   TM1638_LKM1638(PinName mosi, PinName miso, PinName sclk, PinName cs);
+#endif
+
+ /** Constructor for class for driving TM1638 LED controller as used in LKM1638 on a shared bus
+   *
+   * @param  TM1638_Bus &bus Shared SPI bus
+   * @param  PinName cs CS pin of this module
+   */
+  TM1638_LKM1638(TM1638_Bus &bus, PinName cs);
 
 #if DOXYGEN_ONLY
     /** Write a character to the Display
@@ -674,6 +1157,28 @@ class TM1638_LKM1638 : public TM1638, public Stream {
     void setUDC(unsigned char udc_idx, int udc_data);
 
 
+    /** Render a string to digit patterns without writing the display
+     *
+     *  @brief '.' and ',' are folded into the DP of the preceding digit, a leading or repeated DP
+     *         takes a digit of its own. Characters that can not be shown render as a blank digit.
+     *  @param  const char *str characters to render, need not be terminated
+     *  @param  int length number of characters in str
+     *  @param  char *patterns destination for one segment pattern per digit
+     *  @param  int size max number of digits in patterns
+     *  @return int number of digits rendered
+     */
+    int renderString(const char *str, int length, char *patterns, int size);
+
+    /** Display digit patterns starting at a screen column
+     *
+     *  @brief Icons are preserved and only the digits covered by the patterns are written.
+     *  @param  const char *patterns one segment pattern per digit, eg from renderString()
+     *  @param  int digits number of patterns
+     *  @param  int column start column, indexed from 0
+     *  @return int column following the last digit written
+     */
+    int displayPatterns(const char *patterns, int digits, int column = 0);
+
    /** Number of screen columns
     *
     * @param none
@@ -684,20 +1189,20 @@ class TM1638_LKM1638 : public TM1638, public Stream {
    /** Write databyte to TM1638
      *  @param  char data byte written at given address   
      *  @param  int address display memory location to write byte
-     *  @return none
+     *  @return int number of bytes saved
      */ 
-    void writeData(char data, int address){
-      TM1638::writeData(data, address);
+    int writeData(char data, int address){
+      return TM1638::writeData(data, address);
     }        
 
    /** Write Display datablock to TM1638
     *  @param  DisplayData_t data Array of TM1638_DISPLAY_MEM (=16) bytes for displaydata
     *  @param  length number bytes to write (valid range 0..(LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID) (=16), when starting at address 0)  
     *  @param  int address display memory location to write bytes (default = 0) 
-    *  @return none
+    *  @return int number of bytes saved
     */   
-    void writeData(DisplayData_t data, int length = (LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID), int address = 0) {
-      TM1638::writeData(data, length, address);
+    int writeData(const DisplayData_t data, int length = (LKM1638_NR_GRIDS * TM1638_BYTES_PER_GRID), int address = 0) {
+      return TM1638::writeData(data, length, address);
     }  
 
 protected:  
@@ -705,11 +1210,17 @@ protected:
     virtual int _putc(int value);
     virtual int _getc();
 
+   /** Look up the segment pattern for a character
+     *  @param  int value character
+     *  @param  char *pattern segment pattern
+     *  @return bool true when the character can be shown
+     */
+    virtual bool _getPattern(int value, char *pattern);
+
 private:
     int _column;
     int _columns;   
     
-    DisplayData_t _displaybuffer;
     UDCData_t _UDC_7S; 
 };
 #endif
@@ -0,0 +1,424 @@
+/* mbed TM1638 Library, animation player for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "TM1638_Anim.h"
+
+/** Constructor for class for playing frame animations
+ *
+ *  @param  TM1638 &display display to write
+ */
+TM1638_Animator::TM1638_Animator(TM1638 &display) {
+
+  _display   = &display;
+  _animation = NULL;
+  _delta     = NULL;
+  _count     = 0;
+  _offset    = 0;
+  memset(_work, 0, TM1638_DISPLAY_MEM);
+  _flags     = ANIM_ONCE;
+  _frame     = 0;
+  _playing   = false;
+
+#if defined(__MBED__)
+  _queue      = NULL;
+  _id         = 0;
+  _generation = 0;
+#endif
+}
+
+
+/** Destructor for class for playing frame animations, cancels the animation
+ */
+TM1638_Animator::~TM1638_Animator() {
+  cancel();
+}
+
+
+#if defined(__MBED__)
+/** Schedule the next frame, cancels a pending one
+ *  @param  int delay time in ms until the frame, 0 only cancels
+ *  @return none
+ */
+void TM1638_Animator::_schedule(int delay) {
+
+  // A frame that is already running when it is cancelled sees a new generation and drops out
+  _generation++;
+
+  if (_id != 0) {
+    _queue->cancel(_id);
+    _id = 0;
+  }
+
+  if (delay > 0) {
+    _id = _queue->call_in(std::chrono::milliseconds(delay), this, &TM1638_Animator::_queuedStep, _generation);
+  }
+}
+
+
+/** Frame from the event queue
+ *  @param  int generation schedule that queued the frame
+ *  @return none
+ */
+void TM1638_Animator::_queuedStep(int generation) {
+  Callback<void(bool)> done;
+  int delay;
+
+  _mutex.lock();
+  if (generation == _generation) {
+    _id   = 0;
+    delay = _step(&done);
+
+    if (delay > 0) {
+      _schedule(delay);
+    }
+  }
+  _mutex.unlock();
+
+  // No locks held, the callback may start another animation
+  if (done) {
+    done(true);
+  }
+}
+#endif
+
+
+/** Start an animation, shows the first frame and returns immediately
+ *  @param  const Animation_t &animation frames to play
+ *  @param  int flags AnimFlags (default = ANIM_ONCE)
+ *  @param  done Callback with true when the animation completed, false when it was cancelled (default = none)
+ *  @return none
+ */
+void TM1638_Animator::play(const Animation_t &animation, int flags, Callback<void(bool)> done) {
+  Callback<void(bool)> cancelled, completed;
+
+  _mutex.lock();
+  cancelled = _stop();
+
+  _animation = &animation;
+  _delta     = NULL;
+  _count     = animation.count;
+  completed = _start(flags, done);
+
+  _mutex.unlock();
+
+  // No locks held, the callbacks may start another animation
+  if (cancelled) {
+    cancelled(false);
+  }
+  if (completed) {
+    completed(true);
+  }
+}
+
+
+/** Start a delta animation, shows the keyframe and returns immediately
+ *  @param  const DeltaAnimation_t &animation encoded frames to play
+ *  @param  int flags AnimFlags, ANIM_REVERSE is not supported (default = ANIM_ONCE)
+ *  @param  done Callback with true when the animation completed, false when it was cancelled (default = none)
+ *  @return none
+ */
+void TM1638_Animator::play(const DeltaAnimation_t &animation, int flags, Callback<void(bool)> done) {
+  Callback<void(bool)> cancelled, completed;
+
+  _mutex.lock();
+  cancelled = _stop();
+
+  // Deltas only apply forward
+  _animation = NULL;
+  _delta     = &animation;
+  _count     = animation.count;
+  completed = _start(flags & ~ANIM_REVERSE, done);
+
+  _mutex.unlock();
+
+  // No locks held, the callbacks may start another animation
+  if (cancelled) {
+    cancelled(false);
+  }
+  if (completed) {
+    completed(true);
+  }
+}
+
+
+/** Start playing from the first frame, the caller holds the mutex
+ *  @param  int flags AnimFlags
+ *  @param  done Callback for the end of the animation
+ *  @return Callback<void(bool)> done when there are no frames to play, for the caller to call after unlocking
+ */
+Callback<void(bool)> TM1638_Animator::_start(int flags, Callback<void(bool)> done) {
+
+  _flags   = flags;
+  _frame   = (flags & ANIM_REVERSE) ? (_count - 1) : 0;
+  _offset  = 0;
+  _done    = done;
+  _playing = (_count > 0);
+
+  if (!_playing) {
+    _done = nullptr;
+    return done;
+  }
+
+  _show();
+
+#if defined(__MBED__)
+  if (_queue == NULL) {
+    _queue = mbed_event_queue();
+  }
+  _schedule(_duration());
+#endif
+
+  return nullptr;
+}
+
+
+/** Stop the animation, the display keeps the current frame
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Animator::cancel() {
+  Callback<void(bool)> done = _stop();
+
+  if (done) {
+    done(false);
+  }
+}
+
+
+/** Stop playing
+ *  @param  none
+ *  @return Callback<void(bool)> done of the animation that was playing, for the caller to call after unlocking
+ */
+Callback<void(bool)> TM1638_Animator::_stop() {
+  Callback<void(bool)> done;
+
+  _mutex.lock();
+
+  if (_playing) {
+    _playing = false;
+    done     = _done;
+    _done    = nullptr;
+
+#if defined(__MBED__)
+    _schedule(0);
+#endif
+  }
+
+  _mutex.unlock();
+
+  return done;
+}
+
+
+/** Show the next frame
+ *  @param  none
+ *  @return int time in ms until the next frame is due, 0 when the animation is done
+ */
+int TM1638_Animator::step() {
+  Callback<void(bool)> done;
+  int delay = _step(&done);
+
+  if (done) {
+    done(true);
+  }
+
+  return delay;
+}
+
+
+/** Show the next frame, the done callback is returned instead of called
+ *  @param  done Callback<void(bool)> *done set to the callback of an animation that completed
+ *  @return int time in ms until the next frame is due, 0 when the animation is done
+ */
+int TM1638_Animator::_step(Callback<void(bool)> *done) {
+  int next, delay;
+
+  _mutex.lock();
+
+  if (!_playing) {
+    _mutex.unlock();
+    return 0;
+  }
+
+  next = (_flags & ANIM_REVERSE) ? (_frame - 1) : (_frame + 1);
+
+  if ((next < 0) || (next >= _count)) {
+    if (!(_flags & ANIM_LOOP)) {
+      *done = _stop();
+      _mutex.unlock();
+      return 0;
+    }
+
+    // A delta animation restarts from its keyframe
+    next    = (_flags & ANIM_REVERSE) ? (_count - 1) : 0;
+    _offset = 0;
+  }
+
+  _frame = next;
+  _show();
+  delay = _duration();
+
+  _mutex.unlock();
+
+  return delay;
+}
+
+
+/** Write the current frame, only the bytes that the controller does not hold yet are sent
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Animator::_show() {
+  int first, last;
+
+  if (_delta == NULL) {
+    _display->writeData(_animation->frames[_frame]);
+    return;
+  }
+
+  // Apply the deltas in place and flush only the addresses they touched
+  _offset += decodeFrame(_delta->data + _offset, _work, &first, &last);
+  if (last >= first) {
+    _display->writeData(_work, last - first + 1, first);
+  }
+}
+
+
+/** Duration of the current frame
+ *  @param  none
+ *  @return int time in ms
+ */
+int TM1638_Animator::_duration() {
+  const uint16_t *durations;
+  int duration;
+
+  if (_delta != NULL) {
+    durations = _delta->durations;
+    duration  = _delta->duration;
+  }
+  else {
+    durations = _animation->durations;
+    duration  = _animation->duration;
+  }
+
+  if (durations != NULL) {
+    duration = durations[_frame];
+  }
+
+  return (duration > 0) ? duration : TM1638_ANIM_FRAME_MS;
+}
+
+
+/** Apply one encoded frame to a frame
+ *  @param  const uint8_t *data encoded frame
+ *  @param  char *frame frame of TM1638_DISPLAY_MEM bytes, updated in place
+ *  @param  int *first first address that was written
+ *  @param  int *last last address that was written, less than first when the frame holds the display
+ *  @return int number of bytes of the encoded frame
+ */
+int TM1638_Animator::decodeFrame(const uint8_t *data, char *frame, int *first, int *last) {
+  const uint8_t *ptr = data;
+  int ops, header, address, length;
+
+  *first = TM1638_DISPLAY_MEM;
+  *last  = -1;
+
+  for (ops = *ptr++; ops > 0; ops--) {
+    header  = *ptr++;
+    address = header & TM1638_ANIM_ADR_MSK;
+    length  = ((header >> TM1638_ANIM_LEN_SHIFT) & TM1638_ANIM_LEN_MSK) + 1;
+
+    //sanity check
+    if ((address + length) > TM1638_DISPLAY_MEM) {length = TM1638_DISPLAY_MEM - address;}
+
+    if (header & TM1638_ANIM_RUN) {
+      memset(&frame[address], *ptr++, length);
+    }
+    else {
+      memcpy(&frame[address], ptr, length);
+      ptr += length;
+    }
+
+    if (address < *first) {*first = address;}
+    if ((address + length - 1) > *last) {*last = address + length - 1;}
+  }
+
+  return ptr - data;
+}
+
+
+/** Encode a frame as the changes to its predecessor
+ *  @param  const char *prev preceding frame of TM1638_DISPLAY_MEM bytes, NULL to encode a keyframe
+ *  @param  const char *frame frame of TM1638_DISPLAY_MEM bytes
+ *  @param  uint8_t *data destination of at most TM1638_ANIM_MAX_FRAME bytes
+ *  @return int number of bytes of the encoded frame
+ */
+int TM1638_Animator::encodeFrame(const char *prev, const char *frame, uint8_t *data) {
+  uint8_t *ptr = data + 1;
+  int ops = 0;
+  int idx = 0, end, run, length;
+
+  while (idx < TM1638_DISPLAY_MEM) {
+    // Skip bytes that did not change, the keyframe writes all of them
+    if ((prev != NULL) && (prev[idx] == frame[idx])) {
+      idx++;
+      continue;
+    }
+
+    // Extent of the changed range
+    for (end = idx + 1; end < TM1638_DISPLAY_MEM; end++) {
+      if ((prev != NULL) && (prev[end] == frame[end])) {
+        break;
+      }
+    }
+
+    // Split the range in runs of 3 or more equal bytes and literals
+    while (idx < end) {
+      for (run = 1; ((idx + run) < end) && (run < TM1638_ANIM_MAX_LEN) && (frame[idx + run] == frame[idx]); run++) {
+      }
+
+      if (run >= 3) {
+        *ptr++ = TM1638_ANIM_RUN | ((run - 1) << TM1638_ANIM_LEN_SHIFT) | idx;
+        *ptr++ = frame[idx];
+        idx += run;
+      }
+      else {
+        // Literal up to the next run of 3 or the end of the range
+        for (length = 1; ((idx + length) < end) && (length < TM1638_ANIM_MAX_LEN); length++) {
+          if (((idx + length + 2) < end) &&
+              (frame[idx + length] == frame[idx + length + 1]) && (frame[idx + length] == frame[idx + length + 2])) {
+            break;
+          }
+        }
+
+        *ptr++ = ((length - 1) << TM1638_ANIM_LEN_SHIFT) | idx;
+        memcpy(ptr, &frame[idx], length);
+        ptr += length;
+        idx += length;
+      }
+      ops++;
+    }
+  }
+
+  data[0] = ops;
+
+  return ptr - data;
+}
@@ -0,0 +1,262 @@
+/* mbed TM1638 Library, animation player for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_ANIM_H
+#define TM1638_ANIM_H
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include "TM1638_Host.h"
+#endif
+#include "TM1638.h"
+
+/** A non-blocking frame animation player for TM1638 LED controllers
+ *
+ * @code
+ * #include "mbed.h"
+ * #include "TM1638_Anim.h"
+ *
+ * TM1638_LEDKEY8 LEDKEY8(D11, D12, D13, D10);
+ * TM1638_Animator animator(LEDKEY8);
+ *
+ * // Frames and durations stay in flash
+ * const TM1638::DisplayData_t frames[] = {{S7_A, 0x00, ...}, {0x00, 0x00, S7_A, ...}, ...};
+ * const TM1638_Animator::Animation_t spin = {frames, NULL, sizeof(frames) / sizeof(frames[0]), 100};  // frames of 100 ms
+ *
+ * void spin_done(bool completed) {
+ *   // Called from the event queue thread
+ * }
+ *
+ * int main() {
+ *   animator.play(spin, TM1638_Animator::ANIM_LOOP, spin_done);  // Returns immediately
+ *   ...
+ *   animator.cancel();
+ * }
+ * @endcode
+ *
+ * Delta animations store frame 0 as a keyframe and every next frame as the changes to its predecessor.
+ * They are generated with the host encoder in tools/ and played the same way:
+ *
+ * @code
+ * // tools/tm1638_anim spin < spin.txt > spin.h
+ * #include "spin.h"
+ *
+ *   animator.play(spin, TM1638_Animator::ANIM_LOOP);
+ * @endcode
+ *
+ * Encoded frame:  ops, followed by ops times an op
+ * Op:             header byte  b7    = 1: run, one value byte is written to length addresses
+ *                                      0: literal, length value bytes follow
+ *                              b6..4 = length - 1 (1..8)
+ *                              b3..0 = first display memory address
+ * The keyframe covers all TM1638_DISPLAY_MEM addresses, a frame without ops only holds the display.
+ */
+
+//Default frame duration in ms
+#define TM1638_ANIM_FRAME_MS   100
+
+//Delta animation op header fields
+#define TM1638_ANIM_RUN       0x80
+#define TM1638_ANIM_LEN_SHIFT    4
+#define TM1638_ANIM_LEN_MSK   0x07
+#define TM1638_ANIM_ADR_MSK   0x0F
+#define TM1638_ANIM_MAX_LEN      8
+
+//Max size of one encoded frame: ops count + one header per byte + all bytes
+#define TM1638_ANIM_MAX_FRAME  (1 + 2 * TM1638_DISPLAY_MEM)
+
+
+/** A class for playing frame animations on a TM1638 LED controller
+ *
+ * @brief Each frame is a complete DisplayData_t that is written with writeData(), so only the bytes
+ *        that differ from the previous frame go out on the bus. In the background the frames are
+ *        scheduled one at a time on an EventQueue, play() returns immediately.
+ *        The animation data is not copied and must stay valid while it is playing.
+ *
+ * Note: The frames bypass the local displaybuffer. Anything that flushes the displaybuffer overwrites
+ *       the running animation: commit(), present(), flush(), TM1638_Bus::service() and TM1638_Dimmer
+ *       subframes, as well as drawing calls such as putc() or displayPatterns() (eg a TM1638_Scroller).
+ *       Pause those while an animation plays.
+ */
+class TM1638_Animator {
+ public:
+
+  /** Playback flags
+   */
+  enum AnimFlags {
+    ANIM_ONCE    = 0x00, /**<  Play once from the first to the last frame */
+    ANIM_LOOP    = 0x01, /**<  Restart after the last frame until cancel() */
+    ANIM_REVERSE = 0x02  /**<  Play from the last to the first frame */
+  };
+
+  /** Animation, may be stored in flash
+   */
+  typedef struct {
+    const TM1638::DisplayData_t *frames; /**< Frames */
+    const uint16_t *durations;           /**< Duration in ms per frame, NULL when all frames use duration */
+    uint16_t count;                      /**< Number of frames */
+    uint16_t duration;                   /**< Duration in ms of each frame when durations is NULL, 0 selects TM1638_ANIM_FRAME_MS */
+  } Animation_t;
+
+  /** Delta animation, may be stored in flash
+   */
+  typedef struct {
+    const uint8_t *data;                 /**< Encoded frames, starting with the keyframe */
+    const uint16_t *durations;           /**< Duration in ms per frame, NULL when all frames use duration */
+    uint16_t count;                      /**< Number of frames */
+    uint16_t duration;                   /**< Duration in ms of each frame when durations is NULL, 0 selects TM1638_ANIM_FRAME_MS */
+  } DeltaAnimation_t;
+
+ /** Constructor for class for playing frame animations
+  *
+  *  @param  TM1638 &display display to write
+  */
+  TM1638_Animator(TM1638 &display);
+
+ /** Destructor for class for playing frame animations, cancels the animation
+  *
+  * Note: The done callback of a playing animation is called with false.
+  */
+  ~TM1638_Animator();
+
+#if defined(__MBED__)
+  /** Select the queue that runs the frames
+   *  @param  EventQueue *queue queue that runs the frames (default = shared event queue)
+   *  @return none
+   */
+  void setQueue(EventQueue *queue) { _queue = queue; }
+#endif
+
+  /** Start an animation, shows the first frame and returns immediately
+   *  @param  const Animation_t &animation frames to play
+   *  @param  int flags AnimFlags (default = ANIM_ONCE)
+   *  @param  done Callback with true when the animation completed, false when it was cancelled (default = none)
+   *  @return none
+   *
+   * Note: An animation that is still playing is cancelled first. The done callbacks are called
+   *       after the new animation started, without locks held.
+   */
+  void play(const Animation_t &animation, int flags = ANIM_ONCE, Callback<void(bool)> done = nullptr);
+
+  /** Start a delta animation, shows the keyframe and returns immediately
+   *  @param  const DeltaAnimation_t &animation encoded frames to play
+   *  @param  int flags AnimFlags, ANIM_REVERSE is not supported (default = ANIM_ONCE)
+   *  @param  done Callback with true when the animation completed, false when it was cancelled (default = none)
+   *  @return none
+   *
+   * Note: An animation that is still playing is cancelled first. The done callbacks are called
+   *       after the new animation started, without locks held.
+   */
+  void play(const DeltaAnimation_t &animation, int flags = ANIM_ONCE, Callback<void(bool)> done = nullptr);
+
+  /** Apply one encoded frame to a frame
+   *  @param  const uint8_t *data encoded frame
+   *  @param  char *frame frame of TM1638_DISPLAY_MEM bytes, updated in place
+   *  @param  int *first first address that was written
+   *  @param  int *last last address that was written, less than first when the frame holds the display
+   *  @return int number of bytes of the encoded frame
+   */
+  static int decodeFrame(const uint8_t *data, char *frame, int *first, int *last);
+
+  /** Encode a frame as the changes to its predecessor
+   *  @param  const char *prev preceding frame of TM1638_DISPLAY_MEM bytes, NULL to encode a keyframe
+   *  @param  const char *frame frame of TM1638_DISPLAY_MEM bytes
+   *  @param  uint8_t *data destination of at most TM1638_ANIM_MAX_FRAME bytes
+   *  @return int number of bytes of the encoded frame
+   */
+  static int encodeFrame(const char *prev, const char *frame, uint8_t *data);
+
+  /** Stop the animation, the display keeps the current frame
+   *  @param  none
+   *  @return none
+   */
+  void cancel();
+
+  /** An animation is playing
+   *  @return bool playing
+   */
+  bool isPlaying() const { return _playing; }
+
+  /** Current frame
+   *  @return int frame index
+   */
+  int getFrame() const { return _frame; }
+
+  /** Show the next frame
+   *  @param  none
+   *  @return int time in ms until the next frame is due, 0 when the animation is done
+   */
+  int step();
+
+ private:
+  TM1638 *_display;
+
+  const Animation_t *_animation;
+  const DeltaAnimation_t *_delta;
+  int _count;
+  int _flags;
+  int _frame;
+  volatile bool _playing;
+  Callback<void(bool)> _done;
+
+  PlatformMutex _mutex;
+
+  // Delta animations: read position and the frame the deltas apply to
+  int _offset;
+  char _work[TM1638_DISPLAY_MEM];
+
+  /** Start playing from the first frame, returns done when there are no frames to play
+   */
+  Callback<void(bool)> _start(int flags, Callback<void(bool)> done);
+
+  /** Write the current frame
+   */
+  void _show();
+
+  /** Duration of the current frame
+   */
+  int _duration();
+
+  /** Stop playing, returns the done callback of the animation that was playing
+   */
+  Callback<void(bool)> _stop();
+
+  /** Show the next frame, returns the done callback of an animation that completed
+   */
+  int _step(Callback<void(bool)> *done);
+
+#if defined(__MBED__)
+  EventQueue *_queue;
+  int _id;
+  int _generation;
+
+  /** Schedule the next frame, cancels a pending one
+   */
+  void _schedule(int delay);
+
+  /** Frame from the event queue
+   */
+  void _queuedStep(int generation);
+#endif
+};
+
+#endif
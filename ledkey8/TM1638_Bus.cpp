@@ -0,0 +1,505 @@
+/* mbed TM1638 Library, shared bus for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "TM1638_Bus.h"
+
+/** Constructor for class for sharing one bus between TM1638 LED controllers
+ */
+TM1638_Bus::TM1638_Bus() {
+  _busy    = false;
+  _devices = 0;
+  _next    = 0;
+  for (int slot=0; slot < TM1638_BUS_MAX_DEVICES; slot++) {
+    _device[slot] = NULL;
+  }
+}
+
+
+/** Attach a TM1638 module to the bus, called by the TM1638 constructor
+ *  @param  TM1638 *device module
+ *  @param  PinName cs CS pin of the module
+ *  @return int slot of the module on the bus, -1 when the bus is full
+ */
+int TM1638_Bus::attach(TM1638 *device, PinName cs) {
+  int slot;
+
+  lock();
+
+  // Reuse the first free slot, modules may have been detached
+  for (slot=0; slot < TM1638_BUS_MAX_DEVICES; slot++) {
+    if (_device[slot] == NULL) {
+      break;
+    }
+  }
+
+  //sanity check
+  if (slot >= TM1638_BUS_MAX_DEVICES) {
+    unlock();
+    return -1;
+  }
+
+  gpio_init_out_ex(&_cs[slot], cs, 1); // CS inactive
+  _device[slot] = device;
+  for (int idx=0; idx < TM1638_KEY_MEM; idx++) {
+    _keydata[slot][idx] = 0x00;
+  }
+
+  _devices++;
+  unlock();
+  return slot;
+}
+
+
+/** Detach a TM1638 module from the bus, called by the TM1638 destructor
+ *  @param  int slot of the module
+ *  @return none
+ */
+void TM1638_Bus::detach(int slot) {
+
+  //sanity check
+  if ((slot < 0) || (slot >= TM1638_BUS_MAX_DEVICES)) {
+    return;
+  }
+
+  // A pending transfer still reads the buffer of the module
+  waitIdle();
+
+  lock();
+  if (_device[slot] != NULL) {
+    _device[slot] = NULL;
+    _devices--;
+  }
+  unlock();
+}
+
+
+/** Service the next module in round-robin order: flush its displaybuffer and scan its keys
+ *  @param  none
+ *  @return int slot of the module that was serviced, -1 when no modules are attached
+ */
+int TM1638_Bus::service() {
+  int slot;
+  TM1638::KeyData_t keydata;
+
+  // Modules are not detached while they are serviced
+  lock();
+
+  if (_devices == 0) {
+    unlock();
+    return -1;
+  }
+
+  // Skip the slots of detached modules
+  do {
+    slot  = _next;
+    _next = (_next + 1) % TM1638_BUS_MAX_DEVICES;
+  } while (_device[slot] == NULL);
+
+  // Only changed bytes go out, an unchanged frame costs no bus traffic
+  _device[slot]->flush();
+
+  if (_device[slot]->getKeys(&keydata)) {
+    for (int idx=0; idx < TM1638_KEY_MEM; idx++) {
+      _keydata[slot][idx] = keydata[idx];
+    }
+    if (_keys) {
+      _keys(slot, _keydata[slot]);
+    }
+  }
+  else {
+    for (int idx=0; idx < TM1638_KEY_MEM; idx++) {
+      _keydata[slot][idx] = 0x00;
+    }
+  }
+
+  unlock();
+  return slot;
+}
+
+
+/** Service all attached modules once
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Bus::serviceAll() {
+  for (int cnt=0; cnt < _devices; cnt++) {
+    service();
+  }
+}
+
+
+/** Select a module: wait for a pending transfer and activate its CS
+ *  @param  int slot of the module
+ *  @return none
+ */
+void TM1638_Bus::select(int slot) {
+  waitIdle();
+  gpio_write(&_cs[slot], 0);
+  wait_us(1);    
+}
+
+
+/** Deselect a module: release its CS
+ *  @param  int slot of the module
+ *  @return none
+ */
+void TM1638_Bus::deselect(int slot) {
+  wait_us(1);
+  gpio_write(&_cs[slot], 1);
+}
+
+
+/** Wait until the bus is free for a blocking transfer, sleeps until a pending transfer is done
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Bus::waitIdle() {
+  while (_busy) {
+#if defined(__MBED__)
+    // A flag left by an earlier transfer only costs one more check of _busy
+    _idle.wait_any(TM1638_BUS_IDLE_FLAG);
+#endif
+  }
+}
+
+
+/** Mark a pending transfer as done and wake up the threads in waitIdle(), allowed in interrupt context
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Bus::_setIdle() {
+  _busy = false;
+#if defined(__MBED__)
+  _idle.set(TM1638_BUS_IDLE_FLAG);
+#endif
+}
+
+
+#if DEVICE_SPI_ASYNCH
+/** Send a prebuilt wire buffer to a module, blocking fallback for buses without asynchronous transfers
+ *  @param  int slot of the module
+ *  @param  const char *data wire buffer
+ *  @param  int length number of bytes to send
+ *  @param  done Callback invoked with the SPI event when the transfer is done (optional)
+ *  @return bool true
+ */
+bool TM1638_Bus::writeAsync(int slot, const char *data, int length, const event_callback_t &done) {
+
+  select(slot);
+  for (int idx=0; idx < length; idx++) {
+    write(data[idx]);
+  }
+  deselect(slot);
+
+  if (done) {
+    done(SPI_EVENT_COMPLETE);
+  }
+
+  return true;
+}
+#endif
+
+
+#if defined(__MBED__)
+/** Constructor for class for sharing one SPI bus between TM1638 LED controllers
+ *
+ *  @param  PinName mosi, miso, sclk SPI bus pins
+ *  @param  int frequency SPI bus clock (default = TM1638_BUS_FREQ)
+ */
+TM1638_SPIBus::TM1638_SPIBus(PinName mosi, PinName miso, PinName sclk, int frequency) : _spi(mosi,miso,sclk) {
+
+//init SPI, once for all modules
+  _spi.format(8,3); //TM1638 uses mode 3 (Clock High on Idle, Data latched on second (=rising) edge)
+  _spi.frequency(frequency);   
+#if DEVICE_SPI_ASYNCH
+  _spi.set_dma_usage(DMA_USAGE_OPPORTUNISTIC);
+  _asyncSlot = 0;
+#endif
+}
+
+
+#if DEVICE_SPI_ASYNCH
+/** Send a prebuilt wire buffer to a module without blocking the caller
+ *  @param  int slot of the module
+ *  @param  const char *data wire buffer, must remain valid until the transfer is done
+ *  @param  int length number of bytes to send
+ *  @param  done Callback invoked from interrupt context with the SPI event when the transfer is done (optional)
+ *  @return bool true when the transfer was started, false when the bus is busy
+ */
+bool TM1638_SPIBus::writeAsync(int slot, const char *data, int length, const event_callback_t &done) {
+
+  if (_busy) {
+    return false;
+  }
+
+  _asyncSlot = slot;
+  _asyncDone = done;
+  _busy = true;
+
+  gpio_write(&_cs[slot], 0);
+  wait_us(1);
+  if (_spi.transfer(data, length, (char *) NULL, 0, callback(this, &TM1638_SPIBus::_transferDone), SPI_EVENT_COMPLETE) != 0) {
+    // Peripheral is busy, release the module
+    gpio_write(&_cs[slot], 1);
+    _setIdle();
+    return false;
+  }
+
+  return true;
+}
+
+
+/** Completion handler for asynchronous transfers, releases CS and notifies the caller
+  *  @param  int event SPI event flags
+  *  @return none
+  */
+void TM1638_SPIBus::_transferDone(int event) {
+  wait_us(1);
+  gpio_write(&_cs[_asyncSlot], 1);
+  _setIdle();
+
+  if (_asyncDone) {
+    _asyncDone(event);
+  }
+}
+#endif
+
+
+/** Constructor for class for sharing one bit-banged bus between TM1638 LED controllers
+ *
+ *  @param  PinName dio, clk bus pins
+ *  @param  int bitPeriod clock period in ns (default = TM1638_GPIO_BIT_NS, TM1638 allows 1000 ns minimum)
+ *  @param  int turnaround delay in us between the key read cmd and the first data bit (default = TM1638_GPIO_TURN_US)
+ */
+TM1638_GPIOBus::TM1638_GPIOBus(PinName dio, PinName clk, int bitPeriod, int turnaround) {
+
+//init GPIO, CLK is high on idle (same as SPI mode 3)
+  gpio_init_out_ex(&_clk, clk, 1);
+  gpio_init_inout(&_dio, dio, PIN_OUTPUT, PullUp, 1);
+
+  _halfPeriod = bitPeriod / 2;
+  _turnaround = turnaround;
+  _reading    = false;
+}
+
+
+/** Select a module: drive DIO and activate its STB
+ *  @param  int slot of the module
+ *  @return none
+ */
+void TM1638_GPIOBus::select(int slot) {
+  if (_reading) {
+    gpio_dir(&_dio, PIN_OUTPUT);
+    _reading = false;
+  }
+
+  TM1638_Bus::select(slot);
+}
+
+
+/** Write one byte on the bus, the TM1638 latches DIO on the rising edge of CLK
+ *  @param  char data byte to write (wire order, MSB first)
+ *  @return char 0xFF
+ */
+char TM1638_GPIOBus::write(char data) {
+
+  if (_reading) {
+    gpio_dir(&_dio, PIN_OUTPUT);
+    _reading = false;
+  }
+
+  for (int bit=0; bit < 8; bit++) {
+    gpio_write(&_clk, 0);
+    gpio_write(&_dio, (data & 0x80) ? 1 : 0);
+    wait_ns(_halfPeriod);
+    gpio_write(&_clk, 1);
+    wait_ns(_halfPeriod);
+    data = data << 1;
+  }
+
+  return 0xFF;
+}
+
+
+/** Read one byte from the selected module, the TM1638 shifts out DIO on the falling edge of CLK
+ *  @param  none
+ *  @return char data byte read (wire order, MSB first)
+ */
+char TM1638_GPIOBus::read() {
+  char data = 0x00;
+
+  if (!_reading) {
+    // Release DIO and give the TM1638 time to take over the line
+    gpio_write(&_dio, 1);
+    gpio_dir(&_dio, PIN_INPUT);
+    wait_us(_turnaround);
+    _reading = true;
+  }
+
+  for (int bit=0; bit < 8; bit++) {
+    gpio_write(&_clk, 0);
+    wait_ns(_halfPeriod);
+    gpio_write(&_clk, 1);
+    data = (data << 1) | (gpio_read(&_dio) ? 0x01 : 0x00);
+    wait_ns(_halfPeriod);
+  }
+
+  return data;
+}
+#endif
+
+
+/** Constructor for class for recording the traffic to TM1638 LED controllers
+ */
+TM1638_RecorderBus::TM1638_RecorderBus() {
+
+  for (int slot=0; slot < TM1638_BUS_MAX_DEVICES; slot++) {
+    for (int idx=0; idx < TM1638_DISPLAY_MEM; idx++) {
+      _display[slot][idx] = 0x00;
+    }
+    for (int idx=0; idx < TM1638_KEY_MEM; idx++) {
+      _keydata[slot][idx] = 0x00;
+    }
+    _dataSet[slot] = TM1638_STATE_UNKNOWN;
+    _dspCtrl[slot] = TM1638_STATE_UNKNOWN;
+  }
+
+  _slot    = -1;
+  _cmd     = TM1638_STATE_UNKNOWN;
+  _address = 0;
+  _keyIdx  = 0;
+
+  clear();
+}
+
+
+/** Select a module: start a new transaction
+ *  @param  int slot of the module
+ *  @return none
+ */
+void TM1638_RecorderBus::select(int slot) {
+  waitIdle();
+  _slot   = slot;
+  _cmd    = TM1638_STATE_UNKNOWN;
+  _keyIdx = 0;
+  _transactions++;
+}
+
+
+/** Deselect a module: end the transaction
+ *  @param  int slot of the module
+ *  @return none
+ */
+void TM1638_RecorderBus::deselect(int slot) {
+  (void) slot;
+  _slot = -1;
+}
+
+
+/** Write one byte, decoded into the model of the selected module
+ *  The first byte after select is the command, the next bytes are display data after an address set command.
+ *  Display data is only stored when the module is in write mode, like the controller does.
+ *  @param  char data byte to write (wire order)
+ *  @return char 0xFF
+ */
+char TM1638_RecorderBus::write(char data) {
+  uint8_t value = (uint8_t) TM1638_FLIP[(uint8_t) data];  // logical order
+
+  if (_bytes < TM1638_REC_LOG_SIZE) {
+    _log[_bytes] = value;
+  }
+  _bytes++;
+
+  //no module selected, the controller ignores the byte
+  if (_slot < 0) {
+    return 0xFF;
+  }
+
+  if (_cmd == TM1638_STATE_UNKNOWN) {
+    //command byte
+    _cmd = value;
+
+    switch (value & TM1638_CMD_MSK) {
+      case TM1638_DATA_SET_CMD :
+        _dataSet[_slot] = value;
+        break;
+
+      case TM1638_ADDR_SET_CMD :
+        _address = value & TM1638_ADDR_MSK;
+        break;
+
+      case TM1638_DSP_CTRL_CMD :
+        _dspCtrl[_slot] = value;
+        break;
+    }
+  }
+  else if (((_cmd & TM1638_CMD_MSK) == TM1638_ADDR_SET_CMD) &&
+           (_dataSet[_slot] != TM1638_STATE_UNKNOWN) &&
+           ((_dataSet[_slot] & TM1638_KEY_RD) == 0)) {
+    //display data
+    _display[_slot][_address] = value;
+
+    if ((_dataSet[_slot] & TM1638_ADDR_FIXED) == 0) {
+      _address = (_address + 1) & TM1638_ADDR_MSK;
+    }
+  }
+
+  return 0xFF;
+}
+
+
+/** Read one byte of keydata from the selected module
+ *  @param  none
+ *  @return char data byte read (wire order)
+ */
+char TM1638_RecorderBus::read() {
+
+  if ((_slot < 0) || (_keyIdx >= TM1638_KEY_MEM)) {
+    return 0xFF;
+  }
+
+  return TM1638_FLIP[(uint8_t) _keydata[_slot][_keyIdx++]];
+}
+
+
+/** Set the keydata returned by the next key reads of a module
+ *  @param  int slot of the module
+ *  @param  const char *keydata Array of TM1638_KEY_MEM (=4) bytes for keydata
+ *  @return none
+ */
+void TM1638_RecorderBus::setKeys(int slot, const char *keydata) {
+  for (int idx=0; idx < TM1638_KEY_MEM; idx++) {
+    _keydata[slot][idx] = keydata[idx];
+  }
+}
+
+
+/** Clear the log and the counters, the model of the modules is kept
+ *  @param  none
+ *  @return none
+ */
+void TM1638_RecorderBus::clear() {
+  for (int idx=0; idx < TM1638_REC_LOG_SIZE; idx++) {
+    _log[idx] = 0x00;
+  }
+  _bytes        = 0;
+  _transactions = 0;
+}
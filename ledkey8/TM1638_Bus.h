@@ -0,0 +1,420 @@
+/* mbed TM1638 Library, shared SPI bus for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_BUS_H
+#define TM1638_BUS_H
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include "TM1638_Host.h"
+#endif
+#include "TM1638.h"
+
+/** A shared bus for one or more TM1638 LED controllers
+ *
+ * @code
+ * #include "mbed.h"
+ * #include "TM1638_Bus.h" 
+ *
+ * // Shared SPI bus (mosi, miso, sclk), each module has its own CS pin
+ * TM1638_SPIBus bus(D11, D12, D13);
+ * // or a bit-banged bus on any two GPIO pins (dio, clk)
+ * // TM1638_GPIOBus bus(D2, D3);
+ * // or an in-memory bus without hardware, eg for a host build
+ * // TM1638_RecorderBus bus;
+ * TM1638_LEDKEY8 panel0(bus, D10);
+ * TM1638_LEDKEY8 panel1(bus, D9);
+ *
+ * int main() {
+ *   panel0.setDeferred(true);
+ *   panel1.setDeferred(true);
+ *
+ *   while (1) {
+ *     panel0.setIcon(TM1638_LEDKEY8::LD1);  // Changes are kept in the local displaybuffer..
+ *     panel1.clrIcon(TM1638_LEDKEY8::LD1);
+ *     bus.serviceAll();                     // ..and flushed here, together with a key scan of each module
+ *   }
+ * }
+ * @endcode
+ */
+
+//Max number of TM1638 modules on one bus
+#define TM1638_BUS_MAX_DEVICES  8
+
+//Default SPI bus clock
+#define TM1638_BUS_FREQ    500000
+
+//Default bit period and read turnaround for the bit-banged bus
+#define TM1638_GPIO_BIT_NS      2000
+#define TM1638_GPIO_TURN_US     2
+
+//Event flag set when a pending transfer is done
+#define TM1638_BUS_IDLE_FLAG    0x01
+
+//Size of the byte log of the recorder bus
+#define TM1638_REC_LOG_SIZE     256
+
+
+/** A class for sharing one bus between TM1638 LED controllers
+ *
+ * @brief Base class for the bus implementations. Owns the CS (STB) pins of all attached modules.
+ *        Frame flushes and key scans are scheduled round-robin across the modules.
+ *        The derived classes implement the clock and data lines (SPI peripheral or GPIO bit-bang).
+ */
+class TM1638_Bus {
+ public:
+ /** Constructor for class for sharing one bus between TM1638 LED controllers
+  */
+  TM1638_Bus();
+
+  /** Destructor for class for sharing one bus between TM1638 LED controllers
+   */
+  virtual ~TM1638_Bus() {};
+
+  /** Attach a TM1638 module to the bus, called by the TM1638 constructor
+   *  @param  TM1638 *device module
+   *  @param  PinName cs CS pin of the module
+   *  @return int slot of the module on the bus, -1 when the bus is full
+   */
+  int attach(TM1638 *device, PinName cs);
+
+  /** Detach a TM1638 module from the bus, called by the TM1638 destructor
+   *  @param  int slot of the module
+   *  @return none
+   *
+   * Note: Waits for a pending transfer, the slot is reused by the next attach().
+   */
+  void detach(int slot);
+
+  /** Number of attached modules
+   *  @return int devices
+   */
+  int devices() const { return _devices; }
+
+  /** Service the next module in round-robin order: flush its displaybuffer and scan its keys
+   *  @param  none
+   *  @return int slot of the module that was serviced, -1 when no modules are attached
+   */
+  int service();
+
+  /** Service all attached modules once
+   *  @param  none
+   *  @return none
+   */
+  void serviceAll();
+
+  /** Attach a function to be called when a key scan by service() finds pressed keys
+   *  @param  keys Callback with the slot of the module and its keydata
+   *  @return none
+   */
+  void attachKeys(Callback<void(int, const char *)> keys) { _keys = keys; }
+
+  /** Latest keydata of a module, as read by service()
+   *  @param  int slot of the module
+   *  @return const char* Array of TM1638_KEY_MEM (=4) bytes for keydata
+   */
+  const char *getKeys(int slot) const { return _keydata[slot]; }
+
+  /** Lock the bus for a sequence of transactions by one thread, may be nested
+   *  @param  none
+   *  @return none
+   *
+   * Note: The TM1638 methods lock the bus themselves, so a key scan in one thread cannot
+   *       end up between the mode and data commands of a display write in another thread.
+   *       Not allowed in interrupt context.
+   */
+  void lock() { _mutex.lock(); }
+
+  /** Unlock the bus
+   *  @param  none
+   *  @return none
+   */
+  void unlock() { _mutex.unlock(); }
+
+  /** Select a module: wait for a pending transfer and activate its CS
+   *  @param  int slot of the module
+   *  @return none
+   */
+  virtual void select(int slot);
+
+  /** Deselect a module: release its CS
+   *  @param  int slot of the module
+   *  @return none
+   */
+  virtual void deselect(int slot);
+
+  /** Write one byte on the bus
+   *  @param  char data byte to write (wire order, MSB first)
+   *  @return char data byte read while writing (wire order)
+   */
+  virtual char write(char data) = 0;
+
+  /** Read one byte from the selected module
+   *  @param  none
+   *  @return char data byte read (wire order, MSB first)
+   */
+  virtual char read() { return write(0xFF); }
+
+#if DEVICE_SPI_ASYNCH
+  /** Send a prebuilt wire buffer to a module without blocking the caller
+   *  @param  int slot of the module
+   *  @param  const char *data wire buffer, must remain valid until the transfer is done
+   *  @param  int length number of bytes to send
+   *  @param  done Callback invoked with the SPI event when the transfer is done (optional)
+   *  @return bool true when the transfer was started, false when the bus is busy
+   *
+   * Note: The default implementation sends the buffer blocking and calls done before returning.
+   */
+  virtual bool writeAsync(int slot, const char *data, int length, const event_callback_t &done);
+#endif
+
+  /** Check for a pending asynchronous transfer
+   *  @return bool busy
+   */
+  bool isBusy() const { return _busy; }
+
+  /** Wait until the bus is free for a blocking transfer, sleeps until a pending transfer is done
+   *  @param  none
+   *  @return none
+   */
+  void waitIdle();
+
+ protected:
+  gpio_t _cs[TM1638_BUS_MAX_DEVICES];
+  volatile bool _busy;
+
+  /** Mark a pending transfer as done and wake up the threads in waitIdle(), allowed in interrupt context
+   *  @param  none
+   *  @return none
+   */
+  void _setIdle();
+
+#if defined(__MBED__)
+  EventFlags _idle;
+#endif
+
+ private:
+  TM1638 *_device[TM1638_BUS_MAX_DEVICES];
+  char _keydata[TM1638_BUS_MAX_DEVICES][TM1638_KEY_MEM];
+  int _devices;
+  int _next;
+  Callback<void(int, const char *)> _keys;
+  PlatformMutex _mutex;
+};
+
+
+#if defined(__MBED__)
+/** A class for sharing one SPI bus between TM1638 LED controllers
+ *
+ * @brief Owns the SPI peripheral, the format and frequency are configured once for all modules.
+ *        Supports asynchronous transfers when the target has DEVICE_SPI_ASYNCH.
+ */
+class TM1638_SPIBus : public TM1638_Bus {
+ public:
+ /** Constructor for class for sharing one SPI bus between TM1638 LED controllers
+  *
+  *  @param  PinName mosi, miso, sclk SPI bus pins
+  *  @param  int frequency SPI bus clock (default = TM1638_BUS_FREQ)
+  */
+  TM1638_SPIBus(PinName mosi, PinName miso, PinName sclk, int frequency = TM1638_BUS_FREQ);
+
+  /** Write and read one byte on the bus
+   *  @param  char data byte to write (wire order)
+   *  @return char data byte read (wire order)
+   */
+  virtual char write(char data) { return _spi.write(data); }
+
+#if DEVICE_SPI_ASYNCH
+  /** Send a prebuilt wire buffer to a module without blocking the caller
+   *  @param  int slot of the module
+   *  @param  const char *data wire buffer, must remain valid until the transfer is done
+   *  @param  int length number of bytes to send
+   *  @param  done Callback invoked from interrupt context with the SPI event when the transfer is done (optional)
+   *  @return bool true when the transfer was started, false when the bus is busy
+   */
+  virtual bool writeAsync(int slot, const char *data, int length, const event_callback_t &done);
+#endif
+
+ private:
+  SPI _spi;
+
+#if DEVICE_SPI_ASYNCH
+  int _asyncSlot;
+  event_callback_t _asyncDone;
+
+  /** Completion handler for asynchronous transfers, releases CS and notifies the caller
+    *  @param  int event SPI event flags
+    *  @return none
+    */
+  void _transferDone(int event);
+#endif
+};
+
+
+/** A class for sharing one bit-banged 3-wire bus between TM1638 LED controllers
+ *
+ * @brief Drives CLK and the bidirectional DIO line directly through the GPIO port registers,
+ *        no SPI peripheral is needed. STB is the CS pin of each module.
+ *        DIO needs a pull-up (most TM1638 modules have one fitted), it is released for reading.
+ */
+class TM1638_GPIOBus : public TM1638_Bus {
+ public:
+ /** Constructor for class for sharing one bit-banged bus between TM1638 LED controllers
+  *
+  *  @param  PinName dio, clk bus pins
+  *  @param  int bitPeriod clock period in ns (default = TM1638_GPIO_BIT_NS, TM1638 allows 1000 ns minimum)
+  *  @param  int turnaround delay in us between the key read cmd and the first data bit (default = TM1638_GPIO_TURN_US)
+  */
+  TM1638_GPIOBus(PinName dio, PinName clk, int bitPeriod = TM1638_GPIO_BIT_NS, int turnaround = TM1638_GPIO_TURN_US);
+
+  /** Select a module: drive DIO and activate its STB
+   *  @param  int slot of the module
+   *  @return none
+   */
+  virtual void select(int slot);
+
+  /** Write one byte on the bus
+   *  @param  char data byte to write (wire order, MSB first)
+   *  @return char 0xFF
+   */
+  virtual char write(char data);
+
+  /** Read one byte from the selected module, releases DIO before the first byte
+   *  @param  none
+   *  @return char data byte read (wire order, MSB first)
+   */
+  virtual char read();
+
+ private:
+  gpio_t _dio;
+  gpio_t _clk;
+  int _halfPeriod;
+  int _turnaround;
+  bool _reading;
+};
+
+#endif
+
+
+/** An in-memory bus that records the traffic to TM1638 LED controllers
+ *
+ * @brief No hardware is needed, the bus keeps a model of the display memory, the data set
+ *        and the display control state of each attached module, plus a log of all bytes written.
+ *        Key reads return the keydata set by setKeys(). Builds without mbed-os, the transport
+ *        for tests and benchmarks of the driver logic on the host.
+ *        All data is in logical order (LSB first), as used by the driver.
+ */
+class TM1638_RecorderBus : public TM1638_Bus {
+ public:
+ /** Constructor for class for recording the traffic to TM1638 LED controllers
+  */
+  TM1638_RecorderBus();
+
+  /** Select a module: start a new transaction
+   *  @param  int slot of the module
+   *  @return none
+   */
+  virtual void select(int slot);
+
+  /** Deselect a module: end the transaction
+   *  @param  int slot of the module
+   *  @return none
+   */
+  virtual void deselect(int slot);
+
+  /** Write one byte, decoded into the model of the selected module
+   *  @param  char data byte to write (wire order)
+   *  @return char 0xFF
+   */
+  virtual char write(char data);
+
+  /** Read one byte of keydata from the selected module
+   *  @param  none
+   *  @return char data byte read (wire order)
+   */
+  virtual char read();
+
+  /** Set the keydata returned by the next key reads of a module
+   *  @param  int slot of the module
+   *  @param  const char *keydata Array of TM1638_KEY_MEM (=4) bytes for keydata
+   *  @return none
+   */
+  void setKeys(int slot, const char *keydata);
+
+  /** Display memory of a module, as written by the driver
+   *  @param  int slot of the module
+   *  @return const char* Array of TM1638_DISPLAY_MEM (=16) bytes
+   */
+  const char *getDisplay(int slot) const { return _display[slot]; }
+
+  /** Last data set command of a module
+   *  @param  int slot of the module
+   *  @return uint8_t command, TM1638_STATE_UNKNOWN when none was sent
+   */
+  uint8_t getDataSet(int slot) const { return _dataSet[slot]; }
+
+  /** Last display control command of a module
+   *  @param  int slot of the module
+   *  @return uint8_t command, TM1638_STATE_UNKNOWN when none was sent
+   */
+  uint8_t getDspCtrl(int slot) const { return _dspCtrl[slot]; }
+
+  /** Bytes logged since the last clear(), the log keeps the first TM1638_REC_LOG_SIZE bytes
+   *  @param  none
+   *  @return const char* log of bytes written
+   */
+  const char *getLog() const { return _log; }
+
+  /** Number of bytes written since the last clear(), including bytes that did not fit in the log
+   *  @return int bytes
+   */
+  int bytes() const { return _bytes; }
+
+  /** Number of transactions (CS windows) since the last clear()
+   *  @return int transactions
+   */
+  int transactions() const { return _transactions; }
+
+  /** Clear the log and the counters, the model of the modules is kept
+   *  @param  none
+   *  @return none
+   */
+  void clear();
+
+ private:
+  char _display[TM1638_BUS_MAX_DEVICES][TM1638_DISPLAY_MEM];
+  char _keydata[TM1638_BUS_MAX_DEVICES][TM1638_KEY_MEM];
+  // Commands are unsigned, TM1638_STATE_UNKNOWN must compare equal whatever the signedness of char
+  uint8_t _dataSet[TM1638_BUS_MAX_DEVICES];
+  uint8_t _dspCtrl[TM1638_BUS_MAX_DEVICES];
+
+  int _slot;
+  uint8_t _cmd;
+  int _address;
+  int _keyIdx;
+
+  char _log[TM1638_REC_LOG_SIZE];
+  int _bytes;
+  int _transactions;
+};
+
+#endif
@@ -26,12 +26,27 @@
 #define TM1638_CONFIG_H
 
 // Select one of the testboards for TM1638 LED controller
-#define TM1638_TEST  0
+// A build may also select the board on the command line, eg -DLEDKEY8_TEST=0 -DQYF_TEST=1 for the host tests
+#ifndef LEDKEY8_TEST
 #define LEDKEY8_TEST 1 
+#endif
+#ifndef TM1638_TEST
+#define TM1638_TEST  0
+#endif
+#ifndef QYF_TEST
 #define QYF_TEST     0 
+#endif
+#ifndef LKM1638_TEST
 #define LKM1638_TEST 0 
+#endif
  
 // Select the display mode: only digits and hex or ASCII
 #define SHOW_ASCII   1 
 
+// Select to run the benchmarks at startup of the test program
+#define BENCH_TEST   0
+
+// Select to collect key press to display latency histograms
+#define TM1638_LATENCY 0
+
 #endif
\ No newline at end of file
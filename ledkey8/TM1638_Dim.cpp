@@ -0,0 +1,195 @@
+/* mbed TM1638 Library, brightness dithering for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "TM1638_Dim.h"
+
+/** Constructor for class for per byte brightness
+ *
+ *  @param  TM1638 &display display to dim
+ *  @param  int levels number of brightness levels above off (2..TM1638_DIM_MAX_LEVELS, default = TM1638_DIM_LEVELS)
+ *  @param  int period subframe period in ms (default = TM1638_DIM_PERIOD_AUTO)
+ */
+TM1638_Dimmer::TM1638_Dimmer(TM1638 &display, int levels, int period) {
+
+  _display = &display;
+
+  //sanity check
+  if (levels < 2)                     {levels = 2;}
+  if (levels > TM1638_DIM_MAX_LEVELS) {levels = TM1638_DIM_MAX_LEVELS;}
+
+  _levels     = levels;
+  _autoPeriod = (period <= TM1638_DIM_PERIOD_AUTO);
+  _subframeUs = 0;
+  _phase      = 0;
+
+  // Until calibrate() measured the subframe, assume it fits the flicker-free period
+  _period = _autoPeriod ? (1000 / (_levels * TM1638_DIM_MIN_HZ)) : period;
+  if (_period < 1) {_period = 1;}
+
+#if defined(__MBED__)
+  _queue = NULL;
+  _id    = 0;
+#endif
+
+  // All bytes at full level
+  setLevels(0, TM1638_DISPLAY_MEM, _levels);
+}
+
+
+/** Destructor for class for per byte brightness, stops the subframes
+ */
+TM1638_Dimmer::~TM1638_Dimmer() {
+#if defined(__MBED__)
+  stop();
+#endif
+}
+
+
+#if defined(__MBED__)
+/** Start the subframes in the background
+ *  @param  EventQueue *queue queue that runs the subframes (default = shared event queue)
+ *  @return none
+ */
+void TM1638_Dimmer::start(EventQueue *queue) {
+
+  if (_queue != NULL) {
+    return;
+  }
+
+  if (_autoPeriod) {
+    calibrate();
+  }
+
+  _display->setDeferred(true);
+
+  _queue = queue;
+  _id    = _queue->call_every(std::chrono::milliseconds(_period), this, &TM1638_Dimmer::subframe);
+}
+
+
+/** Stop the subframes, the display shows the local displaybuffer at full level again
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Dimmer::stop() {
+
+  if (_queue == NULL) {
+    return;
+  }
+
+  _queue->cancel(_id);
+  _queue = NULL;
+  _id    = 0;
+
+  _display->setDeferred(false);
+  _display->flush();
+}
+#endif
+
+
+/** Measure the worst case subframe and select the period
+ *  @param  none
+ *  @return int period in ms
+ */
+int TM1638_Dimmer::calibrate() {
+  TM1638::DisplayData_t frame;
+  uint32_t start;
+  int shortest, longest;
+
+  // Worst case subframe: every byte is sent. The controller already shows this content.
+  _display->copyDisplayBuffer(frame);
+  _display->invalidate();
+  start = us_ticker_read();
+  _display->writeData(frame);
+  _subframeUs = (int) (us_ticker_read() - start);
+
+  // The period is a whole number of ms and must leave time for the write,
+  // a longer period than needed for TM1638_DIM_MIN_HZ only costs bus time
+  shortest = (_subframeUs / 1000) + 1;
+  longest  = 1000 / (_levels * TM1638_DIM_MIN_HZ);
+  _period  = (longest > shortest) ? longest : shortest;
+
+  return _period;
+}
+
+
+/** Set the level of a range of the display memory
+ *  @param  int address first display memory location
+ *  @param  int length number of bytes
+ *  @param  int level 0 (off) .. levels (full)
+ *  @return none
+ */
+void TM1638_Dimmer::setLevels(int address, int length, int level) {
+  uint16_t on[TM1638_DIM_MAX_LEVELS];
+
+  //sanity check
+  address &= TM1638_ADDR_MSK;
+  if ((address + length) > TM1638_DISPLAY_MEM) {length = TM1638_DISPLAY_MEM - address;}
+  if (level < 0)       {level = 0;}
+  if (level > _levels) {level = _levels;}
+
+  for (int idx=address; idx < (address + length); idx++) {
+    _level[idx] = level;
+  }
+
+  // Spread the on subframes of each level evenly over the window (Bresenham),
+  // so a byte at level n toggles as often as possible and flickers least
+  for (int phase=0; phase < _levels; phase++) {
+    on[phase] = 0;
+    for (int idx=0; idx < TM1638_DISPLAY_MEM; idx++) {
+      if ((((phase + 1) * _level[idx]) / _levels) != ((phase * _level[idx]) / _levels)) {
+        on[phase] |= (1 << idx);
+      }
+    }
+  }
+
+  // Each mask is stored in one access, a subframe never sees a half updated mask
+  for (int phase=0; phase < _levels; phase++) {
+    _on[phase] = on[phase];
+  }
+}
+
+
+/** Write the next subframe
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Dimmer::subframe() {
+  TM1638::DisplayData_t frame;
+  uint16_t on = _on[_phase];
+
+  // Snapshot of the displaybuffer, consistent with the frames of other producers
+  _display->copyDisplayBuffer(frame);
+
+  for (int idx=0; idx < TM1638_DISPLAY_MEM; idx++) {
+    if ((on & (1 << idx)) == 0) {
+      frame[idx] = 0x00;
+    }
+  }
+
+  // Only the bytes that toggle in this subframe are sent
+  _display->writeData(frame);
+
+  _phase++;
+  if (_phase >= _levels) {
+    _phase = 0;
+  }
+}
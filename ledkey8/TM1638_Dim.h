@@ -0,0 +1,180 @@
+/* mbed TM1638 Library, brightness dithering for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_DIM_H
+#define TM1638_DIM_H
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include "TM1638_Host.h"
+#endif
+#include "TM1638.h"
+
+/** Per digit and per LED brightness for TM1638 LED controllers
+ *
+ * @code
+ * #include "mbed.h"
+ * #include "TM1638_Dim.h"
+ *
+ * TM1638_LEDKEY8 LEDKEY8(D11, D12, D13, D10);
+ * TM1638_Dimmer dimmer(LEDKEY8);      // 4 levels, the subframe period is selected by start()
+ *
+ * int main() {
+ *   LEDKEY8.displayStringAt("12345678", 0);
+ *   dimmer.setLevels(0, 8, 1);        // Digits 1..4 at 1/4
+ *   dimmer.setLevel(8, 4);            // Digit 5 at full brightness
+ *   dimmer.start();                   // Subframes run on the shared event queue
+ *   ...
+ * }
+ * @endcode
+ */
+
+//Default number of brightness levels above off, level n shows a byte in n of the subframes of a refresh
+#define TM1638_DIM_LEVELS        4
+
+//Max number of brightness levels
+#define TM1638_DIM_MAX_LEVELS   16
+
+//Subframe period selected by calibrate() from the measured time of a worst case subframe (default)
+#define TM1638_DIM_PERIOD_AUTO   0
+
+//Lowest refresh rate in Hz without visible flicker, calibrate() aims for it
+#define TM1638_DIM_MIN_HZ      100
+
+
+/** A class for per byte brightness by time multiplexed subframes
+ *
+ * @brief The TM1638 only has one global brightness. The dimmer shows each byte of the local displaybuffer
+ *        (one digit or one LED) in a number of the subframes of every refresh window, spread evenly
+ *        over the window. Each subframe goes out as a diff-only write, so only the bytes that toggle
+ *        in that subframe are sent and the bus load is bounded by the number of dimmed bytes.
+ *        While running, the display is deferred: putc, setIcon, cls etc only change the local
+ *        displaybuffer and the next subframe shows them.
+ *        A refresh window is levels * period ms. With TM1638_DIM_PERIOD_AUTO the period is derived from
+ *        a measured worst case subframe: the longest whole ms period that keeps the refresh rate at or above
+ *        TM1638_DIM_MIN_HZ, but never shorter than the subframe write (see calibrate() and bench_dim()).
+ */
+class TM1638_Dimmer {
+ public:
+
+ /** Constructor for class for per byte brightness
+  *
+  *  @param  TM1638 &display display to dim
+  *  @param  int levels number of brightness levels above off (2..TM1638_DIM_MAX_LEVELS, default = TM1638_DIM_LEVELS)
+  *  @param  int period subframe period in ms (default = TM1638_DIM_PERIOD_AUTO)
+  */
+  TM1638_Dimmer(TM1638 &display, int levels = TM1638_DIM_LEVELS, int period = TM1638_DIM_PERIOD_AUTO);
+
+ /** Destructor for class for per byte brightness, stops the subframes
+  */
+  ~TM1638_Dimmer();
+
+#if defined(__MBED__)
+  /** Start the subframes in the background, calibrates the period first when it is TM1638_DIM_PERIOD_AUTO
+   *  @param  EventQueue *queue queue that runs the subframes (default = shared event queue)
+   *  @return none
+   */
+  void start(EventQueue *queue = mbed_event_queue());
+
+  /** Stop the subframes, the display shows the local displaybuffer at full level again
+   *  @param  none
+   *  @return none
+   */
+  void stop();
+#endif
+
+  /** Set the level of one byte of the display memory
+   *  @param  int address display memory location, eg digit n is 2n and its LED is 2n+1 on LEDKEY8
+   *  @param  int level 0 (off) .. levels (full)
+   *  @return none
+   */
+  void setLevel(int address, int level) { setLevels(address, 1, level); }
+
+  /** Set the level of a range of the display memory
+   *  @param  int address first display memory location
+   *  @param  int length number of bytes
+   *  @param  int level 0 (off) .. levels (full)
+   *  @return none
+   */
+  void setLevels(int address, int length, int level);
+
+  /** Get the level of one byte of the display memory
+   *  @param  int address display memory location
+   *  @return int level
+   */
+  int getLevel(int address) const { return _level[address & TM1638_ADDR_MSK]; }
+
+  /** Number of brightness levels above off
+   *  @return int levels
+   */
+  int getLevels() const { return _levels; }
+
+  /** Refresh rate of the levels
+   *  @return int refresh rate in Hz
+   */
+  int getRefreshRate() const { return 1000 / (_levels * _period); }
+
+  /** Subframe period
+   *  @return int period in ms
+   */
+  int getPeriod() const { return _period; }
+
+  /** Time of the worst case subframe as measured by calibrate()
+   *  @return int time in us, 0 when not measured
+   */
+  int getSubframeTime() const { return _subframeUs; }
+
+  /** Measure the worst case subframe and select the period
+   *  @param  none
+   *  @return int period in ms
+   *
+   * Note: All 16 bytes of the displaybuffer are resent once, the display content does not change.
+   *       Call while the dimmer is stopped.
+   */
+  int calibrate();
+
+  /** Write the next subframe
+   *  @param  none
+   *  @return none
+   */
+  void subframe();
+
+ private:
+  TM1638 *_display;
+
+  int _levels;
+  int _period;
+  bool _autoPeriod;
+  int _subframeUs;
+  int _phase;
+  uint8_t _level[TM1638_DISPLAY_MEM];
+
+  // Bytes that are on in each subframe, bit n is address n
+  uint16_t _on[TM1638_DIM_MAX_LEVELS];
+
+#if defined(__MBED__)
+  EventQueue *_queue;
+  int _id;
+#endif
+};
+
+#endif
@@ -0,0 +1,208 @@
+/* mbed TM1638 Library, brightness fader for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "TM1638_Fade.h"
+
+/** Constructor for class for fading the brightness
+ *
+ *  @param  TM1638 &display display to fade
+ *  @param  int step step period in ms (default = TM1638_FADE_STEP_MS)
+ */
+TM1638_Fader::TM1638_Fader(TM1638 &display, int step) {
+
+  _display = &display;
+
+  //sanity check
+  if (step < 1) {step = 1;}
+  _period = step;
+
+  // The controller starts at the default brightness
+  _level     = levelOf(TM1638_BRT_DEF);
+  _start     = _level;
+  _target    = _level;
+  _steps     = 0;
+  _stepsLeft = 0;
+  _phase     = 0;
+
+  _sentOn     = false;
+  _sentBright = -1;
+
+#if defined(__MBED__)
+  _queue = NULL;
+  _id    = 0;
+#endif
+}
+
+
+/** Destructor for class for fading the brightness, cancels the queued steps
+ */
+TM1638_Fader::~TM1638_Fader() {
+#if defined(__MBED__)
+  _mutex.lock();
+  if (_id != 0) {
+    _queue->cancel(_id);
+    _id = 0;
+  }
+  _mutex.unlock();
+#endif
+}
+
+
+/** Fade to a level, returns immediately
+ *  @param  int level 0 (off) .. TM1638_FADE_MAX
+ *  @param  int duration fade time in ms, 0 sets the level at once
+ *  @param  done Callback when the level is reached (default = none)
+ *  @return none
+ */
+void TM1638_Fader::fadeTo(int level, int duration, Callback<void()> done) {
+
+  //sanity check
+  if (level < 0)               {level = 0;}
+  if (level > TM1638_FADE_MAX) {level = TM1638_FADE_MAX;}
+  if (duration < 0)            {duration = 0;}
+
+  _mutex.lock();
+
+  _start     = _level;
+  _target    = level;
+  _steps     = duration / _period;
+  _stepsLeft = _steps;
+  _done      = done;
+
+  // Without steps the level is set now, the first step of a fade follows after one period
+  if (_steps == 0) {
+    _level = _target;
+    _done  = nullptr;
+  }
+  _apply();
+
+#if defined(__MBED__)
+  if (_queue == NULL) {
+    _queue = mbed_event_queue();
+  }
+  if (_active() && (_id == 0)) {
+    _id = _queue->call_every(std::chrono::milliseconds(_period), this, &TM1638_Fader::_queuedStep);
+  }
+#endif
+
+  _mutex.unlock();
+
+  if ((_steps == 0) && done) {
+    done();
+  }
+}
+
+
+/** Advance the fade and the duty cycle by one step
+ *  @param  none
+ *  @return int time in ms until the next step is due, 0 when no more steps are needed
+ */
+int TM1638_Fader::step() {
+  Callback<void()> done;
+  int delay;
+
+  _mutex.lock();
+
+  if (_stepsLeft > 0) {
+    _stepsLeft--;
+
+    // Linear in the steps, rounded towards the start level
+    _level = _target - (((_target - _start) * _stepsLeft) / _steps);
+
+    if (_stepsLeft == 0) {
+      done  = _done;
+      _done = nullptr;
+    }
+  }
+
+  _apply();
+
+  delay = _active() ? _period : 0;
+
+#if defined(__MBED__)
+  // Stop the queued steps, a fade started by the done callback schedules them again
+  if ((delay == 0) && (_id != 0)) {
+    _queue->cancel(_id);
+    _id = 0;
+  }
+#endif
+
+  _mutex.unlock();
+
+  // No locks held, the callback may start the next fade
+  if (done) {
+    done();
+  }
+
+  return delay;
+}
+
+
+/** Steps are needed
+ *  @param  none
+ *  @return bool a fade is running or the level needs the on/off duty cycle
+ */
+bool TM1638_Fader::_active() const {
+  return (_stepsLeft > 0) || ((_level > 0) && (_level < TM1638_FADE_DUTY));
+}
+
+
+/** Send the display control state of the current level when it changed
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Fader::_apply() {
+  bool on;
+  int bright;
+
+  if (_level >= TM1638_FADE_DUTY) {
+    on     = true;
+    bright = _level - TM1638_FADE_DUTY;
+  }
+  else {
+    // On in _level of TM1638_FADE_DUTY steps, spread evenly
+    on     = ((((_phase + 1) * _level) / TM1638_FADE_DUTY) != ((_phase * _level) / TM1638_FADE_DUTY));
+    bright = TM1638_BRT0;
+
+    _phase++;
+    if (_phase >= TM1638_FADE_DUTY) {
+      _phase = 0;
+    }
+  }
+
+  // At most one display control cmd per step, none when nothing changed
+  if ((on != _sentOn) || (bright != _sentBright)) {
+    _display->setDisplay(on, bright);
+    _sentOn     = on;
+    _sentBright = bright;
+  }
+}
+
+
+#if defined(__MBED__)
+/** Step from the event queue, step() stops the steps when they are no longer needed
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Fader::_queuedStep() {
+  step();
+}
+#endif
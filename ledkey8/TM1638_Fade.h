@@ -0,0 +1,166 @@
+/* mbed TM1638 Library, brightness fader for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_FADE_H
+#define TM1638_FADE_H
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include "TM1638_Host.h"
+#endif
+#include "TM1638.h"
+
+/** A non-blocking brightness fader for TM1638 LED controllers
+ *
+ * @code
+ * #include "mbed.h"
+ * #include "TM1638_Fade.h"
+ *
+ * TM1638_LEDKEY8 LEDKEY8(D11, D12, D13, D10);
+ * TM1638_Fader fader(LEDKEY8);
+ *
+ * int main() {
+ *   fader.setLevel(0);                                            // Display off
+ *   fader.fadeTo(TM1638_Fader::levelOf(TM1638_BRT4), 1000);       // Fade in over 1 s, returns immediately
+ *   ...
+ *   fader.fadeTo(1, 500);                                         // Dim below BRT0
+ * }
+ * @endcode
+ */
+
+//Default step period in ms, also the period of the on/off duty cycle below BRT0
+#define TM1638_FADE_STEP_MS      3
+
+//Number of on/off duty cycle steps below BRT0, level n of these shows the display in n of the steps at BRT0
+#define TM1638_FADE_DUTY         3
+
+//Brightest fade level, level 0 is off, TM1638_FADE_DUTY is BRT0
+#define TM1638_FADE_MAX         (TM1638_FADE_DUTY + TM1638_BRT7)
+
+
+/** A class for fading the brightness of a TM1638 LED controller
+ *
+ * @brief The fade levels extend the 8 brightness settings of the TM1638 downwards: level 0 is off,
+ *        levels 1 .. TM1638_FADE_DUTY - 1 switch the display on at BRT0 in part of the steps,
+ *        level TM1638_FADE_DUTY + n is BRTn. A fade interpolates the level over the steps of its duration.
+ *        Each step sends at most one display control cmd and none when the state did not change.
+ *        In the background the steps run on an EventQueue, they stop when the fade is done
+ *        unless the level needs the on/off duty cycle.
+ */
+class TM1638_Fader {
+ public:
+
+ /** Constructor for class for fading the brightness
+  *
+  *  @param  TM1638 &display display to fade
+  *  @param  int step step period in ms (default = TM1638_FADE_STEP_MS)
+  */
+  TM1638_Fader(TM1638 &display, int step = TM1638_FADE_STEP_MS);
+
+ /** Destructor for class for fading the brightness, cancels the queued steps
+  */
+  ~TM1638_Fader();
+
+#if defined(__MBED__)
+  /** Select the queue that runs the steps
+   *  @param  EventQueue *queue queue that runs the steps (default = shared event queue)
+   *  @return none
+   */
+  void setQueue(EventQueue *queue) { _queue = queue; }
+#endif
+
+  /** Fade level of a TM1638 brightness setting
+   *  @param  char brightness TM1638_BRT0 .. TM1638_BRT7
+   *  @return int level
+   */
+  static int levelOf(char brightness) { return TM1638_FADE_DUTY + (brightness & TM1638_BRT_MSK); }
+
+  /** Set the level at once, stops a fade
+   *  @param  int level 0 (off) .. TM1638_FADE_MAX
+   *  @return none
+   */
+  void setLevel(int level) { fadeTo(level, 0); }
+
+  /** Fade to a level, returns immediately
+   *  @param  int level 0 (off) .. TM1638_FADE_MAX
+   *  @param  int duration fade time in ms, 0 sets the level at once
+   *  @param  done Callback when the level is reached (default = none)
+   *  @return none
+   *
+   * Note: A fade that is still running is replaced, it continues from the current level.
+   */
+  void fadeTo(int level, int duration, Callback<void()> done = nullptr);
+
+  /** Current level
+   *  @return int level
+   */
+  int getLevel() const { return _level; }
+
+  /** A fade is running
+   *  @return bool fading
+   */
+  bool isFading() const { return (_stepsLeft > 0); }
+
+  /** Advance the fade and the duty cycle by one step
+   *  @param  none
+   *  @return int time in ms until the next step is due, 0 when no more steps are needed
+   */
+  int step();
+
+ private:
+  TM1638 *_display;
+  int _period;
+
+  // Fade from _start to _target in _steps steps
+  int _start;
+  int _target;
+  int _steps;
+  volatile int _stepsLeft;
+  int _level;
+  int _phase;
+  Callback<void()> _done;
+
+  // Display control state as last sent, _sentBright < 0 when unknown
+  bool _sentOn;
+  int _sentBright;
+
+  PlatformMutex _mutex;
+
+  /** Steps are needed
+   */
+  bool _active() const;
+
+  /** Send the display control state of the current level when it changed
+   */
+  void _apply();
+
+#if defined(__MBED__)
+  EventQueue *_queue;
+  int _id;
+
+  /** Step from the event queue
+   */
+  void _queuedStep();
+#endif
+};
+
+#endif
@@ -0,0 +1,172 @@
+/* mbed TM1638 Library, host build support for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_HOST_H
+#define TM1638_HOST_H
+
+/** The minimal subset of mbed-os used by the driver, for builds without mbed-os
+ *
+ * @brief Included by TM1638.h and TM1638_Bus.h when __MBED__ is not defined, so the driver logic
+ *        builds with a plain C++ compiler (eg g++ on Linux) for tests and benchmarks.
+ *        Pins are plain numbers and do nothing, use the TM1638_RecorderBus as transport.
+ *        The driver does not depend on the signedness of char, no extra compiler flags are needed.
+ *
+ * @code
+ * // g++ -Iledkey8 host.cpp ledkey8/TM1638.cpp ledkey8/TM1638_Bus.cpp ledkey8/Font_7Seg.cpp
+ * #include "TM1638_Bus.h"
+ *
+ * TM1638_RecorderBus bus;
+ * TM1638_LEDKEY8 LEDKEY8(bus, 0);
+ *
+ * int main() {
+ *   LEDKEY8.cls();
+ *   LEDKEY8.setIcon(TM1638_LEDKEY8::LD1);
+ *   printf("%d bytes in %d transactions\n", bus.bytes(), bus.transactions());
+ * }
+ * @endcode
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <functional>
+#include <mutex>
+#include <chrono>
+
+//Pins
+typedef int PinName;
+#define NC  ((PinName) -1)
+
+//GPIO HAL, no hardware behind it
+typedef struct {
+  PinName pin;
+  int value;
+} gpio_t;
+
+typedef enum {
+  PIN_INPUT,
+  PIN_OUTPUT
+} PinDirection;
+
+inline void gpio_init_out_ex(gpio_t *obj, PinName pin, int value) { obj->pin = pin; obj->value = value; }
+inline void gpio_write(gpio_t *obj, int value) { obj->value = value; }
+inline int  gpio_read(gpio_t *obj) { return obj->value; }
+inline void gpio_dir(gpio_t *obj, PinDirection direction) { (void) obj; (void) direction; }
+
+//Delays, the host does not need bus timing
+inline void wait_us(int us) { (void) us; }
+inline void wait_ns(unsigned int ns) { (void) ns; }
+
+//Free running us timer
+inline uint32_t us_ticker_read() {
+  return (uint32_t) std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//Fatal runtime error
+inline void error(const char *format, ...) {
+  va_list args;
+  va_start(args, format);
+  vfprintf(stderr, format, args);
+  va_end(args);
+  abort();
+}
+
+//Atomic access for the lock free queues
+inline uint32_t core_util_atomic_load_u32(const volatile uint32_t *valuePtr) { return __atomic_load_n(valuePtr, __ATOMIC_ACQUIRE); }
+inline void core_util_atomic_store_u32(volatile uint32_t *valuePtr, uint32_t desiredValue) { __atomic_store_n(valuePtr, desiredValue, __ATOMIC_RELEASE); }
+
+//Critical section for state shared with interrupt handlers, a process wide lock on the host
+inline std::recursive_mutex &host_critical_section() {
+  static std::recursive_mutex mutex;
+  return mutex;
+}
+inline void core_util_critical_section_enter() { host_critical_section().lock(); }
+inline void core_util_critical_section_exit() { host_critical_section().unlock(); }
+
+//Thread identity, a distinct address per thread
+typedef void *osThreadId_t;
+namespace ThisThread {
+inline osThreadId_t get_id() {
+  static thread_local char id;
+  return &id;
+}
+}
+
+//Function callbacks
+template <typename F>
+using Callback = std::function<F>;
+
+//Recursive mutex for the bus lock
+class PlatformMutex {
+ public:
+  void lock() { _mutex.lock(); }
+  void unlock() { _mutex.unlock(); }
+
+ private:
+  std::recursive_mutex _mutex;
+};
+
+//Millisecond clock for the key event timestamps
+namespace Kernel {
+struct Clock {
+  typedef std::chrono::milliseconds duration;
+  typedef duration::rep rep;
+  typedef duration::period period;
+  typedef std::chrono::time_point<Clock> time_point;
+  static const bool is_steady = true;
+
+  static time_point now() {
+    return time_point(std::chrono::duration_cast<duration>(std::chrono::steady_clock::now().time_since_epoch()));
+  }
+};
+}
+
+/** Character stream, as used by the display classes for putc() and printf()
+ */
+class Stream {
+ public:
+  Stream(const char *name = NULL) { (void) name; }
+  virtual ~Stream() {};
+
+  int putc(int c) { return _putc(c); }
+  int getc() { return _getc(); }
+
+  int printf(const char *format, ...) {
+    char buffer[64];
+    va_list args;
+    va_start(args, format);
+    int r = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    for (int idx=0; (idx < r) && (idx < (int) sizeof(buffer) - 1); idx++) {
+      _putc(buffer[idx]);
+    }
+    return r;
+  }
+
+ protected:
+  virtual int _putc(int value) = 0;
+  virtual int _getc() = 0;
+};
+
+#endif
@@ -0,0 +1,389 @@
+/* mbed TM1638 Library, key scanner for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "TM1638_Keys.h"
+
+/** Constructor for class for scanning the keys of a TM1638 LED controller
+ *
+ *  @param  TM1638 &device module to scan
+ *  @param  int fast scan period in ms while keys are active (default = TM1638_SCAN_FAST_MS)
+ *  @param  int idle scan period in ms without key activity (default = TM1638_SCAN_IDLE_MS)
+ *  @param  int debounce number of equal scans before a key changes state (default = TM1638_DEBOUNCE_CNT)
+ *  @param  int longpress hold time in ms for a long press event, 0 disables (default = TM1638_LONGPRESS_MS)
+ */
+TM1638_KeyScanner::TM1638_KeyScanner(TM1638 &device, int fast, int idle, int debounce, int longpress) {
+
+  _device    = &device;
+  _longpress = longpress;
+
+  //sanity check, the integrators are chars
+  if (debounce < 1)   {debounce = 1;}
+  if (debounce > 100) {debounce = 100;}
+  _debounce = debounce;
+
+  _state    = 0;
+  _settling = 0;
+  _longDone = 0;
+  for (int key=0; key < TM1638_NR_KEYS; key++) {
+    _integrator[key] = 0;
+    _pressTime[key]  = 0;
+  }
+
+  _events = NULL;
+
+#if (TM1638_LATENCY == 1)
+  _scanStamp = 0;
+#endif
+
+#if defined(__MBED__)
+  _queue   = NULL;
+  _pending = false;
+#endif
+
+  // Start idle, the first pressed scan switches to the fast rate
+  _period     = 0;
+  _lastActive = 0;
+  setRates(fast, idle);
+  resetScanStats();
+}
+
+
+#if defined(__MBED__)
+/** Start scanning in the background
+ *  @param  EventQueue *queue queue that runs the scans (default = shared event queue)
+ *  @return none
+ */
+void TM1638_KeyScanner::start(EventQueue *queue) {
+  _queue   = queue;
+  _pending = false;
+  _ticker.attach(callback(this, &TM1638_KeyScanner::_tick), std::chrono::milliseconds(_period));
+}
+
+
+/** Stop scanning in the background
+ *  @param  none
+ *  @return none
+ */
+void TM1638_KeyScanner::stop() {
+  _ticker.detach();
+  _queue = NULL;
+}
+
+
+/** Ticker handler, queues a scan unless the previous one is still waiting
+ *  @param  none
+ *  @return none
+ */
+void TM1638_KeyScanner::_tick() {
+  if (_pending) {
+    return;
+  }
+
+  _pending = true;
+  if (_queue->call(this, &TM1638_KeyScanner::_queuedScan) == 0) {
+    _pending = false;  // Queue full, try again next tick
+  }
+}
+
+
+/** Scan from the event queue
+ *  @param  none
+ *  @return none
+ */
+void TM1638_KeyScanner::_queuedScan() {
+  _pending = false;
+  scan();
+}
+#endif
+
+
+/** Set the adaptive scan rates
+ *  @param  int fast scan period in ms while keys are active
+ *  @param  int idle scan period in ms without key activity, equal to fast for a fixed rate
+ *  @param  int linger time in ms without key activity before the period starts to back off (default = TM1638_SCAN_LINGER_MS)
+ *  @return none
+ */
+void TM1638_KeyScanner::setRates(int fast, int idle, int linger) {
+
+  //sanity check
+  if (fast < 1)    {fast = 1;}
+  if (idle < fast) {idle = fast;}
+  if (linger < 0)  {linger = 0;}
+
+  _fast   = fast;
+  _idle   = idle;
+  _linger = linger;
+
+  _setPeriod(_idle);
+}
+
+
+/** Reset the key scan statistics
+ */
+void TM1638_KeyScanner::resetScanStats() {
+  _stats.scans       = 0;
+  _stats.activeScans = 0;
+  _stats.idleScans   = 0;
+  _stats.rateChanges = 0;
+  _stats.period      = _period;
+}
+
+
+/** Select the scan period for the next scans
+ *  @param  bool active keys are pressed or settling
+ *  @param  uint32_t time time of the scan in ms
+ *  @return none
+ */
+void TM1638_KeyScanner::_adapt(bool active, uint32_t time) {
+
+  _stats.scans++;
+
+  if (active) {
+    _stats.activeScans++;
+    _lastActive = time;
+
+    // Debounce and release at the fast rate
+    if (_period != _fast) {
+      _setPeriod(_fast);
+    }
+  }
+  else {
+    if (_period == _idle) {
+      _stats.idleScans++;
+    }
+    else if ((time - _lastActive) >= (uint32_t) _linger) {
+      // Back off gradually, a key that is pressed again soon is still picked up quickly
+      _setPeriod(((_period * 2) < _idle) ? (_period * 2) : _idle);
+    }
+  }
+}
+
+
+/** Change the scan period, restarts the Ticker when scanning in the background
+ *  @param  int period scan period in ms
+ *  @return none
+ */
+void TM1638_KeyScanner::_setPeriod(int period) {
+
+  if (period == _period) {
+    return;
+  }
+
+  _period       = period;
+  _stats.period = period;
+  _stats.rateChanges++;
+
+#if defined(__MBED__)
+  if (_queue != NULL) {
+    _ticker.attach(callback(this, &TM1638_KeyScanner::_tick), std::chrono::milliseconds(_period));
+  }
+#endif
+}
+
+
+/** Scan the keys once: read the keydata and update the debounce state
+ *  @param  none
+ *  @return none
+ */
+void TM1638_KeyScanner::scan() {
+  uint32_t held, ambiguous;
+
+#if (TM1638_LATENCY == 1)
+  _scanStamp = TM1638_Latency::stamp();
+#endif
+
+  _device->getKeys(&held, &ambiguous);
+
+  update(held, ambiguous, (uint32_t) Kernel::Clock::now().time_since_epoch().count());
+}
+
+
+/** Update the debounce state with one decoded scan, without bus access
+ *  @param  uint32_t held keys pressed for sure, as returned by TM1638::getKeys()
+ *  @param  uint32_t ambiguous keys that may be a ghost of a chord, these keep their debounced state
+ *  @param  uint32_t time time of the scan in ms
+ *  @return none
+ */
+void TM1638_KeyScanner::update(uint32_t held, uint32_t ambiguous, uint32_t time) {
+  uint32_t raw = held | (ambiguous & _state);
+  uint32_t active, mask;
+  int key;
+
+  // Only keys that differ from their debounced state or are still settling need work
+  active = (raw ^ _state) | _settling;
+
+  for (key=0, mask=1; active != 0; key++, mask <<= 1, active >>= 1) {
+    if ((active & 1) == 0) {
+      continue;
+    }
+
+    if (raw & mask) {
+      if (_integrator[key] < _debounce) {_integrator[key]++;}
+    }
+    else {
+      if (_integrator[key] > 0) {_integrator[key]--;}
+    }
+
+    if ((_integrator[key] == _debounce) && !(_state & mask)) {
+      _state    |= mask;
+      _longDone &= ~mask;
+      _pressTime[key] = time;
+      _emit(key, KEY_PRESS, time);
+    }
+    else if ((_integrator[key] == 0) && (_state & mask)) {
+      _state &= ~mask;
+      _emit(key, KEY_RELEASE, time);
+    }
+
+    if ((_integrator[key] > 0) && (_integrator[key] < _debounce)) {
+      _settling |= mask;
+    }
+    else {
+      _settling &= ~mask;
+    }
+  }
+
+  // Held keys without a long press event yet
+  if (_longpress > 0) {
+    active = _state & ~_longDone;
+
+    for (key=0, mask=1; active != 0; key++, mask <<= 1, active >>= 1) {
+      if ((active & 1) && ((time - _pressTime[key]) >= (uint32_t) _longpress)) {
+        _longDone |= mask;
+        _emit(key, KEY_LONG, time);
+      }
+    }
+  }
+
+  _adapt((_state | _settling | ambiguous | held) != 0, time);
+}
+
+
+/** Report a key event
+ *  @param  int key number
+ *  @param  int type KeyEventType
+ *  @param  uint32_t time time of the scan in ms
+ *  @return none
+ */
+void TM1638_KeyScanner::_emit(int key, int type, uint32_t time) {
+  KeyEvent_t event;
+
+  event.key  = key;
+  event.type = type;
+  event.time = time;
+#if (TM1638_LATENCY == 1)
+  event.stamp = _scanStamp;
+#endif
+
+  if (_events != NULL) {
+    _events->put(event);
+  }
+
+  if (_event) {
+    _event(event);
+  }
+}
+
+
+/** Constructor for class for queueing key events
+ */
+TM1638_KeyQueue::TM1638_KeyQueue() {
+  _head      = 0;
+  _tail      = 0;
+  _overflows = 0;
+  _highWater = 0;
+}
+
+
+/** Add an event, called by the producer, allowed in interrupt context
+ *  @param  const KeyEvent_t &event key event
+ *  @return bool true when the event was queued, false when the queue was full
+ */
+bool TM1638_KeyQueue::put(const TM1638_KeyScanner::KeyEvent_t &event) {
+  uint32_t head = _head;  // own index, no ordering needed
+  uint32_t used = head - core_util_atomic_load_u32(&_tail);
+
+  if (used >= TM1638_KEYQ_SIZE) {
+    _overflows++;
+    return false;
+  }
+
+  _buffer[head % TM1638_KEYQ_SIZE] = event;
+
+  // Publish the event only after it was stored
+  core_util_atomic_store_u32(&_head, head + 1);
+
+  if ((int) (used + 1) > _highWater) {
+    _highWater = used + 1;
+  }
+
+#if defined(__MBED__)
+  _flags.set(TM1638_KEYQ_FLAG);
+#endif
+
+  return true;
+}
+
+
+/** Take the oldest event without blocking, called by the consumer
+ *  @param  KeyEvent_t *event key event
+ *  @return bool true when an event was returned, false when the queue was empty
+ */
+bool TM1638_KeyQueue::get(TM1638_KeyScanner::KeyEvent_t *event) {
+  uint32_t tail = _tail;  // own index, no ordering needed
+
+  if (core_util_atomic_load_u32(&_head) == tail) {
+    return false;
+  }
+
+  *event = _buffer[tail % TM1638_KEYQ_SIZE];
+
+  // Release the slot only after it was read
+  core_util_atomic_store_u32(&_tail, tail + 1);
+
+#if (TM1638_LATENCY == 1)
+  TM1638_latency.dequeued(event->stamp);
+#endif
+
+  return true;
+}
+
+
+#if defined(__MBED__)
+/** Take the oldest event, sleep until one arrives, called by the consumer thread
+ *  @param  KeyEvent_t *event key event
+ *  @param  timeout maximum time to wait (default = forever)
+ *  @return bool true when an event was returned, false on timeout
+ */
+bool TM1638_KeyQueue::wait(TM1638_KeyScanner::KeyEvent_t *event, Kernel::Clock::duration_u32 timeout) {
+
+  // Drop a stale wakeup, an event put after this clear sets the flag again
+  _flags.clear(TM1638_KEYQ_FLAG);
+
+  if (get(event)) {
+    return true;
+  }
+
+  _flags.wait_any_for(TM1638_KEYQ_FLAG, timeout);
+
+  return get(event);
+}
+#endif
@@ -0,0 +1,359 @@
+/* mbed TM1638 Library, key scanner for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_KEYS_H
+#define TM1638_KEYS_H
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include "TM1638_Host.h"
+#endif
+#include "TM1638.h"
+#include "TM1638_Latency.h"
+
+/** A background key scanner for TM1638 LED controllers
+ *
+ * @code
+ * #include "mbed.h"
+ * #include "TM1638_Keys.h"
+ *
+ * TM1638_LEDKEY8 LEDKEY8(D11, D12, D13, D10);
+ * TM1638_KeyScanner keys(LEDKEY8);    // Scan every 5 ms while keys are active, every 50 ms when idle
+ *
+ * void key_event(const TM1638_KeyScanner::KeyEvent_t &event) {
+ *   // Called from the event queue thread, within one scan period of the change
+ *   if (event.type == TM1638_KeyScanner::KEY_PRESS) {
+ *     ...
+ *   }
+ * }
+ *
+ * int main() {
+ *   keys.attach(key_event);
+ *   keys.start();                     // Scans run on the shared event queue
+ *   ...
+ * }
+ *
+ * // or queue the events for any other thread
+ * TM1638_KeyQueue queue;
+ *
+ * int main() {
+ *   TM1638_KeyScanner::KeyEvent_t event;
+ *
+ *   keys.attach(queue);
+ *   keys.start();
+ *   while (1) {
+ *     if (queue.wait(&event, 250ms)) {  // Sleeps until an event arrives or the timeout expires
+ *       ...
+ *     }
+ *   }
+ * }
+ * @endcode
+ */
+
+//Default key scan periods in ms, fast while keys are active and slow when idle
+#define TM1638_SCAN_FAST_MS      5
+#define TM1638_SCAN_IDLE_MS     50
+
+//Default time in ms without key activity before the scan rate starts to back off
+#define TM1638_SCAN_LINGER_MS  500
+
+//Default number of equal scans before a key changes state
+#define TM1638_DEBOUNCE_CNT      3
+
+//Default hold time in ms for a long press event
+#define TM1638_LONGPRESS_MS    800
+
+//Max number of keys, one per bit of the key state
+#define TM1638_NR_KEYS      (TM1638_KEY_MEM * 8)
+
+//Capacity of the key event queue, must be a power of 2
+#define TM1638_KEYQ_SIZE        16
+
+//Event flag used by the key event queue to wake a waiting consumer
+#define TM1638_KEYQ_FLAG    0x0001
+
+class TM1638_KeyQueue;
+
+
+/** A class for scanning the keys of a TM1638 LED controller in the background
+ *
+ * @brief Each key has an integrator that counts up on a pressed scan and down on a released scan,
+ *        the key changes state only when its integrator reaches the limit. The scanner emits
+ *        press, release and long press events with a timestamp. Chords are supported,
+ *        keys that may be a ghost of a chord keep their state until the scan is unambiguous.
+ *        Keys are numbered in the logical order of the board: key 0 is SW1, bit n of the state is key n.
+ *        The scan rate adapts: any pressed or settling key selects the fast period, after the linger
+ *        time without activity the period doubles each scan up to the idle period.
+ *        A Ticker sets the scan rate, the bus transfer itself runs on an EventQueue
+ *        because the SPI bus can not be used in interrupt context.
+ */
+class TM1638_KeyScanner {
+ public:
+
+  /** Key event types
+   */
+  enum KeyEventType {
+    KEY_PRESS   = 0, /**<  Key pressed */
+    KEY_RELEASE,     /**<  Key released */
+    KEY_LONG         /**<  Key held for the long press time, reported once per press */
+  };
+
+  /** Key scan statistics
+   */
+  typedef struct {
+    uint32_t scans;       /**< Number of scans */
+    uint32_t activeScans; /**< Scans with pressed or settling keys */
+    uint32_t idleScans;   /**< Scans at the idle period */
+    uint32_t rateChanges; /**< Number of scan period changes */
+    int period;           /**< Current scan period in ms */
+  } ScanStats_t;
+
+  /** Key event
+   */
+  typedef struct {
+    uint8_t  key;    /**< Key number, 0 is SW1 */
+    uint8_t  type;   /**< KeyEventType */
+    uint32_t time;   /**< Time of the scan that detected the event, in ms of the kernel clock */
+#if (TM1638_LATENCY == 1)
+    uint32_t stamp;  /**< Latency timestamp of the scan, in us */
+#endif
+  } KeyEvent_t;
+
+ /** Constructor for class for scanning the keys of a TM1638 LED controller
+  *
+  *  @param  TM1638 &device module to scan
+  *  @param  int fast scan period in ms while keys are active (default = TM1638_SCAN_FAST_MS)
+  *  @param  int idle scan period in ms without key activity (default = TM1638_SCAN_IDLE_MS)
+  *  @param  int debounce number of equal scans before a key changes state (default = TM1638_DEBOUNCE_CNT)
+  *  @param  int longpress hold time in ms for a long press event, 0 disables (default = TM1638_LONGPRESS_MS)
+  */
+  TM1638_KeyScanner(TM1638 &device, int fast = TM1638_SCAN_FAST_MS, int idle = TM1638_SCAN_IDLE_MS, int debounce = TM1638_DEBOUNCE_CNT, int longpress = TM1638_LONGPRESS_MS);
+
+  /** Attach a function to be called for each key event
+   *  @param  event Callback with the key event, called from the scan context
+   *  @return none
+   */
+  void attach(Callback<void(const KeyEvent_t &)> event) { _event = event; }
+
+  /** Attach a queue that receives all key events
+   *  @param  TM1638_KeyQueue &queue event queue, the scanner is its only producer
+   *  @return none
+   */
+  void attach(TM1638_KeyQueue &queue) { _events = &queue; }
+
+#if defined(__MBED__)
+  /** Start scanning in the background
+   *  @param  EventQueue *queue queue that runs the scans (default = shared event queue)
+   *  @return none
+   */
+  void start(EventQueue *queue = mbed_event_queue());
+
+  /** Stop scanning in the background
+   *  @param  none
+   *  @return none
+   */
+  void stop();
+#endif
+
+  /** Set a fixed scan period, disables the adaptive scan rate
+   *  @param  int period scan period in ms
+   *  @return none
+   */
+  void setPeriod(int period) { setRates(period, period); }
+
+  /** Set the adaptive scan rates
+   *  @param  int fast scan period in ms while keys are active
+   *  @param  int idle scan period in ms without key activity, equal to fast for a fixed rate
+   *  @param  int linger time in ms without key activity before the period starts to back off (default = TM1638_SCAN_LINGER_MS)
+   *  @return none
+   */
+  void setRates(int fast, int idle, int linger = TM1638_SCAN_LINGER_MS);
+
+  /** Get the current scan period
+   *  @return int period scan period in ms
+   */
+  int getPeriod() const { return _period; }
+
+  /** Get the key scan statistics
+   *  @return const ScanStats_t& statistics since start or last reset
+   */
+  const ScanStats_t& getScanStats() const { return _stats; }
+
+  /** Reset the key scan statistics
+   */
+  void resetScanStats();
+
+  /** Scan the keys once: read the keydata and update the debounce state
+   *  @param  none
+   *  @return none
+   */
+  void scan();
+
+  /** Update the debounce state with one decoded scan, without bus access
+   *  @param  uint32_t held keys pressed for sure, as returned by TM1638::getKeys()
+   *  @param  uint32_t ambiguous keys that may be a ghost of a chord, these keep their debounced state
+   *  @param  uint32_t time time of the scan in ms
+   *  @return none
+   */
+  void update(uint32_t held, uint32_t ambiguous, uint32_t time);
+
+  /** Debounced state of a key
+   *  @param  int key number
+   *  @return bool pressed
+   */
+  bool isPressed(int key) const { return (_state >> key) & 1; }
+
+  /** Debounced state of all keys
+   *  @return uint32_t state, bit n is key n
+   */
+  uint32_t getState() const { return _state; }
+
+ private:
+  TM1638 *_device;
+  int _period;
+  int _fast;
+  int _idle;
+  int _linger;
+  uint32_t _lastActive;
+#if (TM1638_LATENCY == 1)
+  uint32_t _scanStamp;
+#endif
+  ScanStats_t _stats;
+  int _debounce;
+  int _longpress;
+
+  uint32_t _state;      // Debounced key state
+  uint32_t _settling;   // Keys with an integrator between the limits
+  uint32_t _longDone;   // Keys with a reported long press
+  char _integrator[TM1638_NR_KEYS];
+  uint32_t _pressTime[TM1638_NR_KEYS];
+
+  Callback<void(const KeyEvent_t &)> _event;
+  TM1638_KeyQueue *_events;
+
+  /** Report a key event
+   *  @param  int key number
+   *  @param  int type KeyEventType
+   *  @param  uint32_t time time of the scan in ms
+   *  @return none
+   */
+  void _emit(int key, int type, uint32_t time);
+
+  /** Select the scan period for the next scans
+   *  @param  bool active keys are pressed or settling
+   *  @param  uint32_t time time of the scan in ms
+   *  @return none
+   */
+  void _adapt(bool active, uint32_t time);
+
+  /** Change the scan period, restarts the Ticker when scanning in the background
+   *  @param  int period scan period in ms
+   *  @return none
+   */
+  void _setPeriod(int period);
+
+#if defined(__MBED__)
+  Ticker _ticker;
+  EventQueue *_queue;
+  volatile bool _pending;
+
+  /** Ticker handler, queues a scan unless the previous one is still waiting
+   *  @param  none
+   *  @return none
+   */
+  void _tick();
+
+  /** Scan from the event queue
+   *  @param  none
+   *  @return none
+   */
+  void _queuedScan();
+#endif
+};
+
+
+/** A queue for key events between one producer and one consumer
+ *
+ * @brief Fixed capacity ring buffer of TM1638_KEYQ_SIZE events, no allocation and no locks.
+ *        The producer (scanner, Ticker or ISR context) only writes the head index,
+ *        the consumer (any one thread) only writes the tail index. A full queue drops the
+ *        new event and counts an overflow. A consumer can sleep on an EventFlags until an event arrives.
+ */
+class TM1638_KeyQueue {
+ public:
+ /** Constructor for class for queueing key events
+  */
+  TM1638_KeyQueue();
+
+  /** Add an event, called by the producer, allowed in interrupt context
+   *  @param  const KeyEvent_t &event key event
+   *  @return bool true when the event was queued, false when the queue was full
+   */
+  bool put(const TM1638_KeyScanner::KeyEvent_t &event);
+
+  /** Take the oldest event without blocking, called by the consumer
+   *  @param  KeyEvent_t *event key event
+   *  @return bool true when an event was returned, false when the queue was empty
+   */
+  bool get(TM1638_KeyScanner::KeyEvent_t *event);
+
+#if defined(__MBED__)
+  /** Take the oldest event, sleep until one arrives, called by the consumer thread
+   *  @param  KeyEvent_t *event key event
+   *  @param  timeout maximum time to wait (default = forever)
+   *  @return bool true when an event was returned, false on timeout
+   */
+  bool wait(TM1638_KeyScanner::KeyEvent_t *event, Kernel::Clock::duration_u32 timeout = Kernel::wait_for_u32_forever);
+#endif
+
+  /** Number of queued events
+   *  @return int count
+   */
+  int count() const { return (int) (core_util_atomic_load_u32(&_head) - core_util_atomic_load_u32(&_tail)); }
+
+  /** Number of events dropped because the queue was full
+   *  @return uint32_t overflows
+   */
+  uint32_t getOverflows() const { return _overflows; }
+
+  /** Largest number of queued events seen by the producer
+   *  @return int high water mark
+   */
+  int getHighWater() const { return _highWater; }
+
+ private:
+  TM1638_KeyScanner::KeyEvent_t _buffer[TM1638_KEYQ_SIZE];
+
+  // Free running indices, the slot is index % TM1638_KEYQ_SIZE
+  volatile uint32_t _head;   // written by the producer only
+  volatile uint32_t _tail;   // written by the consumer only
+
+  // Written by the producer only
+  volatile uint32_t _overflows;
+  volatile int _highWater;
+
+#if defined(__MBED__)
+  EventFlags _flags;
+#endif
+};
+
+#endif
@@ -0,0 +1,215 @@
+/* mbed TM1638 Library, latency histograms for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "TM1638_Latency.h"
+
+#if (TM1638_LATENCY == 1)
+
+TM1638_Latency TM1638_latency;
+
+
+/** Add a sample
+ *  @param  uint32_t us latency in us
+ *  @return none
+ */
+void TM1638_Histogram::add(uint32_t us) {
+  int bucket = 0;
+
+  // Bucket is the number of significant bits
+  if (us != 0) {
+    bucket = 32 - __builtin_clz(us);
+    if (bucket >= TM1638_HIST_BUCKETS) {bucket = TM1638_HIST_BUCKETS - 1;}
+  }
+
+  _bucket[bucket]++;
+  _count++;
+  _sum += us;
+  if (us < _min) {_min = us;}
+  if (us > _max) {_max = us;}
+}
+
+
+/** Clear all samples
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Histogram::reset() {
+  for (int bucket=0; bucket < TM1638_HIST_BUCKETS; bucket++) {
+    _bucket[bucket] = 0;
+  }
+  _count = 0;
+  _min   = 0xFFFFFFFF;
+  _max   = 0;
+  _sum   = 0;
+}
+
+
+/** Print the histogram on the console
+ *  @param  const char *name title of the histogram
+ *  @return none
+ */
+void TM1638_Histogram::print(const char *name) const {
+
+  printf("%s: n=%lu min=%lu mean=%lu max=%lu us\r\n", name,
+         (unsigned long) _count, (unsigned long) getMin(), (unsigned long) getMean(), (unsigned long) _max);
+
+  for (int bucket=0; bucket < TM1638_HIST_BUCKETS; bucket++) {
+    if (_bucket[bucket] == 0) {
+      continue;
+    }
+
+    if (bucket == (TM1638_HIST_BUCKETS - 1)) {
+      printf("  >=%7lu us: %lu\r\n", 1UL << (bucket - 1), (unsigned long) _bucket[bucket]);
+    }
+    else {
+      printf("  < %7lu us: %lu\r\n", 1UL << bucket, (unsigned long) _bucket[bucket]);
+    }
+  }
+}
+
+
+/** Record the dequeue of a key event by the application
+ *  @param  uint32_t scanned timestamp of the scan that detected the event
+ *  @return none
+ */
+void TM1638_Latency::dequeued(uint32_t scanned) {
+  uint32_t now = stamp();
+  osThreadId_t thread = ThisThread::get_id();
+
+  core_util_critical_section_enter();
+  scanToDequeue.add(now - scanned);
+
+  _scanned  = scanned;
+  _dequeued = now;
+  _thread   = thread;
+  _state    = Pending;
+  core_util_critical_section_exit();
+}
+
+
+/** Record a completed blocking display write, closes the measurement of the last dequeued key event
+ *  when called from the thread that dequeued it
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Latency::flushed() {
+  uint32_t now = stamp();
+  osThreadId_t thread = ThisThread::get_id();
+
+  core_util_critical_section_enter();
+  if ((_state == Pending) && (_thread == thread)) {
+    _close(now);
+  }
+  core_util_critical_section_exit();
+}
+
+
+/** Record the start of an asynchronous display write, claims the measurement of the last dequeued key event
+ *  when called from the thread that dequeued it
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Latency::flushStarted() {
+  osThreadId_t thread = ThisThread::get_id();
+
+  core_util_critical_section_enter();
+  if ((_state == Pending) && (_thread == thread)) {
+    _state = Sending;
+  }
+  core_util_critical_section_exit();
+}
+
+
+/** Record a failed start of an asynchronous display write, the claimed measurement is pending again
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Latency::flushFailed() {
+
+  core_util_critical_section_enter();
+  if (_state == Sending) {
+    _state = Pending;
+  }
+  core_util_critical_section_exit();
+}
+
+
+/** Record the completion of an asynchronous display write, closes a claimed measurement
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Latency::flushCompleted() {
+  uint32_t now = stamp();
+
+  core_util_critical_section_enter();
+  if (_state == Sending) {
+    _close(now);
+  }
+  core_util_critical_section_exit();
+}
+
+
+/** Close the measurement, caller holds the critical section
+ *  @param  uint32_t now timestamp of the completed write
+ *  @return none
+ */
+void TM1638_Latency::_close(uint32_t now) {
+  _state = Idle;
+  dequeueToFlush.add(now - _dequeued);
+  scanToFlush.add(now - _scanned);
+}
+
+
+/** Clear all histograms
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Latency::reset() {
+  core_util_critical_section_enter();
+  _state  = Idle;
+  _thread = NULL;
+  scanToDequeue.reset();
+  dequeueToFlush.reset();
+  scanToFlush.reset();
+  core_util_critical_section_exit();
+}
+
+
+/** Print all histograms on the console
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Latency::print() const {
+  TM1638_Histogram dequeue, display, total;
+
+  // Print a consistent copy, the console is too slow for a critical section
+  core_util_critical_section_enter();
+  dequeue = scanToDequeue;
+  display = dequeueToFlush;
+  total   = scanToFlush;
+  core_util_critical_section_exit();
+
+  dequeue.print("Key scan to dequeue");
+  display.print("Dequeue to display");
+  total.print("Key scan to display");
+}
+
+#endif
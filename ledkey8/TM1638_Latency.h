@@ -0,0 +1,204 @@
+/* mbed TM1638 Library, latency histograms for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_LATENCY_H
+#define TM1638_LATENCY_H
+#if defined(__MBED__)
+#include "mbed.h"
+#include "hal/us_ticker_api.h"
+#else
+#include "TM1638_Host.h"
+#endif
+#include "TM1638_Config.h"
+
+#if (TM1638_LATENCY == 1)
+
+/** Key press to display latency histograms
+ *
+ * @brief Select TM1638_LATENCY in TM1638_Config.h. The key scanner stamps each key event at scan time,
+ *        TM1638_KeyQueue::get() records the dequeue and the thread that dequeued the event. The next display
+ *        write from that thread which sends data closes the measurement: a blocking write when it returns,
+ *        writeDataAsync() when the burst completes. Writes from other threads (scroller, animator, dimmer)
+ *        do not react to the key and are ignored. Without TM1638_LATENCY the stamps and hooks are not compiled.
+ *
+ * @code
+ * #include "TM1638_Latency.h"
+ *
+ *   ...
+ *   TM1638_latency.print();   // Histograms on the console
+ *   TM1638_latency.reset();
+ * @endcode
+ */
+
+//Number of histogram buckets, bucket n holds latencies of 2^(n-1) .. 2^n - 1 us, the last bucket holds all longer ones
+#define TM1638_HIST_BUCKETS     20
+
+
+/** A class for a latency histogram with fixed power of 2 buckets
+ */
+class TM1638_Histogram {
+ public:
+ /** Constructor for class for a latency histogram
+  */
+  TM1638_Histogram() { reset(); }
+
+  /** Add a sample
+   *  @param  uint32_t us latency in us
+   *  @return none
+   */
+  void add(uint32_t us);
+
+  /** Clear all samples
+   *  @param  none
+   *  @return none
+   */
+  void reset();
+
+  /** Print the histogram on the console
+   *  @param  const char *name title of the histogram
+   *  @return none
+   */
+  void print(const char *name) const;
+
+  /** Number of samples
+   *  @return uint32_t count
+   */
+  uint32_t getCount() const { return _count; }
+
+  /** Number of samples in a bucket
+   *  @param  int bucket index
+   *  @return uint32_t count
+   */
+  uint32_t getBucket(int bucket) const { return _bucket[bucket]; }
+
+  /** Shortest latency
+   *  @return uint32_t min in us, 0 without samples
+   */
+  uint32_t getMin() const { return (_count > 0) ? _min : 0; }
+
+  /** Longest latency
+   *  @return uint32_t max in us
+   */
+  uint32_t getMax() const { return _max; }
+
+  /** Average latency
+   *  @return uint32_t mean in us, 0 without samples
+   */
+  uint32_t getMean() const { return (_count > 0) ? (uint32_t) (_sum / _count) : 0; }
+
+ private:
+  uint32_t _bucket[TM1638_HIST_BUCKETS];
+  uint32_t _count;
+  uint32_t _min;
+  uint32_t _max;
+  uint64_t _sum;
+};
+
+
+/** A class for the key press to display latency measurement
+ */
+class TM1638_Latency {
+ public:
+ /** Constructor for class for the key press to display latency measurement
+  */
+  TM1638_Latency() { reset(); }
+
+  /** Timestamp for the latency measurement
+   *  @return uint32_t time in us, wraps around
+   */
+  static uint32_t stamp() { return us_ticker_read(); }
+
+  /** Record the dequeue of a key event by the application
+   *  @param  uint32_t scanned timestamp of the scan that detected the event
+   *  @return none
+   */
+  void dequeued(uint32_t scanned);
+
+  /** Record a completed blocking display write, closes the measurement of the last dequeued key event
+   *  when called from the thread that dequeued it
+   *  @param  none
+   *  @return none
+   */
+  void flushed();
+
+  /** Record the start of an asynchronous display write, claims the measurement of the last dequeued key event
+   *  when called from the thread that dequeued it
+   *  @param  none
+   *  @return none
+   */
+  void flushStarted();
+
+  /** Record a failed start of an asynchronous display write, the claimed measurement is pending again
+   *  @param  none
+   *  @return none
+   */
+  void flushFailed();
+
+  /** Record the completion of an asynchronous display write, closes a claimed measurement
+   *  @param  none
+   *  @return none
+   *
+   * Note: Called from interrupt context.
+   */
+  void flushCompleted();
+
+  /** Clear all histograms
+   *  @param  none
+   *  @return none
+   */
+  void reset();
+
+  /** Print all histograms on the console
+   *  @param  none
+   *  @return none
+   */
+  void print() const;
+
+  TM1638_Histogram scanToDequeue;  /**< Key scan to dequeue by the application */
+  TM1638_Histogram dequeueToFlush; /**< Dequeue to the next completed display write */
+  TM1638_Histogram scanToFlush;    /**< Key scan to the next completed display write */
+
+ private:
+  enum State {
+    Idle,    // no key event to measure
+    Pending, // dequeued, waiting for a write from the dequeuing thread
+    Sending  // claimed by an asynchronous write, waiting for its completion
+  };
+
+  /** Close the measurement, caller holds the critical section
+   *  @param  uint32_t now timestamp of the completed write
+   *  @return none
+   */
+  void _close(uint32_t now);
+
+  // State, stamps and histograms are shared with interrupt context, access them in a critical section
+  State _state;
+  osThreadId_t _thread;
+  uint32_t _scanned;
+  uint32_t _dequeued;
+};
+
+// Latency measurement shared by the scanner, the queue and the display writes
+extern TM1638_Latency TM1638_latency;
+
+#endif
+#endif
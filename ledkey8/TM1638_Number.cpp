@@ -0,0 +1,183 @@
+/* mbed TM1638 Library, numeric formatting for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "TM1638_Number.h"
+
+//Digit patterns 0..F, the board segment mapping is applied by the C7_ defines
+static const char DIGITS_7S[16] = {
+  C7_0, C7_1, C7_2, C7_3, C7_4, C7_5, C7_6, C7_7,
+  C7_8, C7_9, C7_A, C7_B, C7_C, C7_D, C7_E, C7_F
+};
+
+//Scale factors for renderFloat()
+static const uint32_t POW10[10] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000};
+
+
+/** Render a signed decimal integer
+ *  @param  int32_t value number to render
+ *  @param  char *patterns destination for width digit patterns
+ *  @param  int width field width in digits
+ *  @param  int flags NumberFlags (default = NUM_RIGHT)
+ *  @return int number of digits rendered, equal to width
+ */
+int TM1638_Number::renderInt(int32_t value, char *patterns, int width, int flags) {
+  return renderFixed(value, 0, patterns, width, flags);
+}
+
+
+/** Render an unsigned hexadecimal integer
+ *  @param  uint32_t value number to render
+ *  @param  char *patterns destination for width digit patterns
+ *  @param  int width field width in digits
+ *  @param  int flags NumberFlags (default = NUM_RIGHT)
+ *  @return int number of digits rendered, equal to width
+ */
+int TM1638_Number::renderHex(uint32_t value, char *patterns, int width, int flags) {
+  return _render(value, false, 16, 0, patterns, width, flags);
+}
+
+
+/** Render a fixed-point number, eg value 12345 with 3 decimals is 12.345
+ *  @param  int32_t value number in units of 10^-decimals
+ *  @param  int decimals number of digits after the DP (valid range 0..9)
+ *  @param  char *patterns destination for width digit patterns
+ *  @param  int width field width in digits
+ *  @param  int flags NumberFlags (default = NUM_RIGHT)
+ *  @return int number of digits rendered, equal to width
+ */
+int TM1638_Number::renderFixed(int32_t value, int decimals, char *patterns, int width, int flags) {
+
+  // Unsigned negate, also correct for INT32_MIN
+  if (value < 0) {
+    return _render(0U - (uint32_t) value, true, 10, decimals, patterns, width, flags);
+  }
+
+  return _render((uint32_t) value, false, 10, decimals, patterns, width, flags);
+}
+
+
+/** Render a floating point number, rounded to a number of decimals
+ *  @param  float value number to render, a value that rounds to 0 is shown without sign
+ *  @param  int decimals number of digits after the DP (valid range 0..9)
+ *  @param  char *patterns destination for width digit patterns
+ *  @param  int width field width in digits
+ *  @param  int flags NumberFlags (default = NUM_RIGHT)
+ *  @return int number of digits rendered, equal to width
+ */
+int TM1638_Number::renderFloat(float value, int decimals, char *patterns, int width, int flags) {
+  bool negative = (value < 0.0f);
+  uint32_t whole, fraction;
+  uint64_t scaled;
+
+  //sanity check
+  if (decimals < 0) {decimals = 0;}
+  if (decimals > 9) {decimals = 9;}
+
+  if (negative) {value = -value;}
+
+  // Too large for 32 bits, infinite or NaN
+  if (!(value < 4294967040.0f)) {
+    return _overflow(patterns, width);
+  }
+
+  // The fraction is exact in a float, scaling it apart from the whole part keeps its digits
+  whole    = (uint32_t) value;
+  fraction = (uint32_t) ((value - (float) whole) * (float) POW10[decimals] + 0.5f);
+  scaled   = ((uint64_t) whole * POW10[decimals]) + fraction;
+
+  if (scaled > 0xFFFFFFFFULL) {
+    return _overflow(patterns, width);
+  }
+
+  // No sign for a number that rounded to 0
+  return _render((uint32_t) scaled, negative && (scaled != 0), 10, decimals, patterns, width, flags);
+}
+
+
+/** Render the magnitude and sign of a number
+ *  @param  uint32_t magnitude absolute value of the number
+ *  @param  bool negative show a minus sign
+ *  @param  uint32_t base number base, 10 or 16
+ *  @param  int decimals number of digits after the DP
+ *  @param  char *patterns destination for width digit patterns
+ *  @param  int width field width in digits
+ *  @param  int flags NumberFlags
+ *  @return int number of digits rendered, equal to width
+ */
+int TM1638_Number::_render(uint32_t magnitude, bool negative, uint32_t base, int decimals, char *patterns, int width, int flags) {
+  char digits[TM1638_NUM_MAX_DIGITS];
+  int count = 0, pad, idx = 0;
+
+  //sanity check
+  if (decimals < 0) {decimals = 0;}
+  if (decimals > (TM1638_NUM_MAX_DIGITS - 1)) {decimals = TM1638_NUM_MAX_DIGITS - 1;}
+
+  // Least significant digit first, at least one digit before the DP
+  do {
+    digits[count++] = DIGITS_7S[magnitude % base];
+    magnitude /= base;
+  } while ((magnitude != 0) || (count <= decimals));
+
+  if (decimals > 0) {
+    digits[decimals] |= S7_DP;
+  }
+
+  pad = width - count - (negative ? 1 : 0);
+  if (pad < 0) {
+    return _overflow(patterns, width);
+  }
+
+  if (flags & NUM_LEFT) {
+    if (negative) {patterns[idx++] = C7_MIN;}
+    while (count > 0) {patterns[idx++] = digits[--count];}
+    while (pad-- > 0) {patterns[idx++] = C7_SPC;}
+  }
+  else if (flags & NUM_ZERO) {
+    if (negative) {patterns[idx++] = C7_MIN;}
+    while (pad-- > 0) {patterns[idx++] = C7_0;}
+    while (count > 0) {patterns[idx++] = digits[--count];}
+  }
+  else {
+    while (pad-- > 0) {patterns[idx++] = C7_SPC;}
+    if (negative) {patterns[idx++] = C7_MIN;}
+    while (count > 0) {patterns[idx++] = digits[--count];}
+  }
+
+  return width;
+}
+
+
+/** Fill the field with dashes for a number that does not fit
+ *  @param  char *patterns destination for width digit patterns
+ *  @param  int width field width in digits
+ *  @return int number of digits rendered, equal to width
+ */
+int TM1638_Number::_overflow(char *patterns, int width) {
+
+  //sanity check
+  if (width < 0) {width = 0;}
+
+  for (int idx=0; idx < width; idx++) {
+    patterns[idx] = C7_MIN;
+  }
+
+  return width;
+}
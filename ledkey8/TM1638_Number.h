@@ -0,0 +1,127 @@
+/* mbed TM1638 Library, numeric formatting for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_NUMBER_H
+#define TM1638_NUMBER_H
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include "TM1638_Host.h"
+#endif
+#include "Font_7Seg.h"
+
+/** Numbers rendered straight to 7 segment digit patterns, without printf
+ *
+ * @brief The renderers fill a field of width digits with segment patterns in the font of the selected board,
+ *        ready for displayPatterns() of TM1638_LEDKEY8, TM1638_QYF or TM1638_LKM1638.
+ *        No text is built and parsed again, no libc printf or heap is used. A DP is folded into the
+ *        units digit and takes no column. A number that does not fit the field is shown as dashes.
+ *
+ * @code
+ * #include "TM1638_Number.h"
+ *
+ * char patterns[LEDKEY8_NR_DIGITS];
+ *
+ *   // "   -0.123", same as printf("%9.3f", -0.1234), the DP takes no digit
+ *   LEDKEY8.displayPatterns(patterns, TM1638_Number::renderFloat(-0.1234f, 3, patterns, 8));
+ *
+ *   // "000012AB", same as printf("%08X", 0x12AB)
+ *   LEDKEY8.displayPatterns(patterns, TM1638_Number::renderHex(0x12AB, patterns, 8, TM1638_Number::NUM_ZERO));
+ * @endcode
+ */
+
+//Max digits of a number without padding: 10 decimal digits for 32 bits
+#define TM1638_NUM_MAX_DIGITS  10
+
+
+/** A class for rendering numbers to 7 segment digit patterns
+ */
+class TM1638_Number {
+ public:
+
+  /** Enums for the field layout */
+  enum NumberFlags {
+    NUM_RIGHT = 0x00, /**<  Right aligned, padded with blanks on the left (default) */
+    NUM_ZERO  = 0x01, /**<  Right aligned, padded with zeros between sign and digits */
+    NUM_LEFT  = 0x02  /**<  Left aligned, padded with blanks on the right */
+  };
+
+  /** Render a signed decimal integer
+   *  @param  int32_t value number to render
+   *  @param  char *patterns destination for width digit patterns
+   *  @param  int width field width in digits
+   *  @param  int flags NumberFlags (default = NUM_RIGHT)
+   *  @return int number of digits rendered, equal to width
+   */
+  static int renderInt(int32_t value, char *patterns, int width, int flags = NUM_RIGHT);
+
+  /** Render an unsigned hexadecimal integer
+   *  @param  uint32_t value number to render
+   *  @param  char *patterns destination for width digit patterns
+   *  @param  int width field width in digits
+   *  @param  int flags NumberFlags (default = NUM_RIGHT)
+   *  @return int number of digits rendered, equal to width
+   */
+  static int renderHex(uint32_t value, char *patterns, int width, int flags = NUM_RIGHT);
+
+  /** Render a fixed-point number, eg value 12345 with 3 decimals is 12.345
+   *  @param  int32_t value number in units of 10^-decimals
+   *  @param  int decimals number of digits after the DP (valid range 0..9)
+   *  @param  char *patterns destination for width digit patterns
+   *  @param  int width field width in digits
+   *  @param  int flags NumberFlags (default = NUM_RIGHT)
+   *  @return int number of digits rendered, equal to width
+   */
+  static int renderFixed(int32_t value, int decimals, char *patterns, int width, int flags = NUM_RIGHT);
+
+  /** Render a floating point number, rounded to a number of decimals
+   *  @param  float value number to render, a value that rounds to 0 is shown without sign
+   *  @param  int decimals number of digits after the DP (valid range 0..9)
+   *  @param  char *patterns destination for width digit patterns
+   *  @param  int width field width in digits
+   *  @param  int flags NumberFlags (default = NUM_RIGHT)
+   *  @return int number of digits rendered, equal to width
+   */
+  static int renderFloat(float value, int decimals, char *patterns, int width, int flags = NUM_RIGHT);
+
+ private:
+  /** Render the magnitude and sign of a number
+   *  @param  uint32_t magnitude absolute value of the number
+   *  @param  bool negative show a minus sign
+   *  @param  uint32_t base number base, 10 or 16
+   *  @param  int decimals number of digits after the DP
+   *  @param  char *patterns destination for width digit patterns
+   *  @param  int width field width in digits
+   *  @param  int flags NumberFlags
+   *  @return int number of digits rendered, equal to width
+   */
+  static int _render(uint32_t magnitude, bool negative, uint32_t base, int decimals, char *patterns, int width, int flags);
+
+  /** Fill the field with dashes for a number that does not fit
+   *  @param  char *patterns destination for width digit patterns
+   *  @param  int width field width in digits
+   *  @return int number of digits rendered, equal to width
+   */
+  static int _overflow(char *patterns, int width);
+};
+
+#endif
@@ -0,0 +1,358 @@
+/* mbed TM1638 Library, scroll engine for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include "TM1638_Scroll.h"
+
+/** Constructor for class for scrolling messages over the display
+ *
+ *  @param  TM1638 &display display to write, any board with digits
+ *  @param  int step time in ms between scroll steps (default = TM1638_SCROLL_STEP_MS)
+ *  @param  int hold time in ms the message is held at its start and end (default = TM1638_SCROLL_HOLD_MS)
+ */
+TM1638_Scroller::TM1638_Scroller(TM1638 &display, int step, int hold) {
+
+  _display = &display;
+  _columns = display.columns();
+
+  //sanity check
+  if (_columns > TM1638_MAX_NR_GRIDS) {_columns = TM1638_MAX_NR_GRIDS;}
+
+  _length = 0;
+  _pos    = 0;
+  _dir    = 1;
+
+  _mode   = SCROLL_PAUSE;
+  _gap    = TM1638_SCROLL_GAP;
+  _paused = false;
+
+#if defined(__MBED__)
+  _queue      = NULL;
+  _id         = 0;
+  _generation = 0;
+#endif
+
+  setSpeed(step, hold);
+}
+
+
+/** Destructor for class for scrolling messages, cancels a pending step
+ */
+TM1638_Scroller::~TM1638_Scroller() {
+#if defined(__MBED__)
+  stop();
+#endif
+}
+
+
+#if defined(__MBED__)
+/** Start scrolling in the background
+ *  @param  EventQueue *queue queue that runs the steps (default = shared event queue)
+ *  @return none
+ */
+void TM1638_Scroller::start(EventQueue *queue) {
+  _mutex.lock();
+  _queue = queue;
+  _id    = 0;
+  if (!_paused) {
+    _schedule(_delay());
+  }
+  _mutex.unlock();
+}
+
+
+/** Stop scrolling in the background, the display keeps the current window
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Scroller::stop() {
+  _mutex.lock();
+  if (_queue != NULL) {
+    _schedule(0);
+    _queue = NULL;
+  }
+  _mutex.unlock();
+}
+
+
+/** Schedule the next step, cancels a pending one
+ *  @param  int delay time in ms until the step, 0 only cancels
+ *  @return none
+ */
+void TM1638_Scroller::_schedule(int delay) {
+
+  // A step that is already running when it is cancelled sees a new generation and drops out
+  _generation++;
+
+  if (_id != 0) {
+    _queue->cancel(_id);
+    _id = 0;
+  }
+
+  if (delay > 0) {
+    _id = _queue->call_in(std::chrono::milliseconds(delay), this, &TM1638_Scroller::_queuedStep, _generation);
+  }
+}
+
+
+/** Step from the event queue
+ *  @param  int generation schedule that queued the step
+ *  @return none
+ */
+void TM1638_Scroller::_queuedStep(int generation) {
+  _mutex.lock();
+  if ((generation == _generation) && (_queue != NULL) && !_paused) {
+    _id = 0;
+    _schedule(step());
+  }
+  _mutex.unlock();
+}
+#endif
+
+
+/** Show a new message from its start
+ *  @param  const char *str characters to show, need not be terminated
+ *  @param  int length number of characters in str
+ *  @return int number of digits of the rendered message
+ */
+int TM1638_Scroller::setText(const char *str, int length) {
+  int digits;
+
+  _mutex.lock();
+
+  _length = _display->renderString(str, length, _patterns, TM1638_SCROLL_SIZE);
+  _restart();
+
+  digits = _length;
+  _mutex.unlock();
+
+  return digits;
+}
+
+
+/** Show a new message of digit patterns from its start
+ *  @param  const char *patterns one segment pattern per digit, eg from renderString() or TM1638_Number
+ *  @param  int digits number of patterns, at most TM1638_SCROLL_SIZE are kept
+ *  @return int number of digits of the message
+ */
+int TM1638_Scroller::setPatterns(const char *patterns, int digits) {
+
+  //sanity check
+  if (digits < 0) {digits = 0;}
+  if (digits > TM1638_SCROLL_SIZE) {digits = TM1638_SCROLL_SIZE;}
+
+  _mutex.lock();
+
+  memcpy(_patterns, patterns, digits);
+  _length = digits;
+  _restart();
+
+  _mutex.unlock();
+
+  return digits;
+}
+
+
+/** Select the scroll mode, restarts the message
+ *  @param  ScrollMode mode
+ *  @return none
+ */
+void TM1638_Scroller::setMode(ScrollMode mode) {
+  _mutex.lock();
+
+  _mode = mode;
+  _restart();
+
+  _mutex.unlock();
+}
+
+
+/** Set the scroll speed, takes effect from the next step
+ *  @param  int step time in ms between scroll steps
+ *  @param  int hold time in ms the message is held at its start and end, at least one step
+ *  @return none
+ */
+void TM1638_Scroller::setSpeed(int step, int hold) {
+
+  //sanity check
+  if (step < 1)    {step = 1;}
+  if (hold < step) {hold = step;}
+
+  _mutex.lock();
+  _step = step;
+  _hold = hold;
+  _mutex.unlock();
+}
+
+
+/** Set the gap between the end and the start of the message in loop mode, restarts the message
+ *  @param  int gap number of blank digits
+ *  @return none
+ */
+void TM1638_Scroller::setGap(int gap) {
+
+  //sanity check
+  if (gap < 0) {gap = 0;}
+
+  _mutex.lock();
+  _gap = gap;
+  _restart();
+  _mutex.unlock();
+}
+
+
+/** Hold the message at the current position
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Scroller::pause() {
+  _mutex.lock();
+  _paused = true;
+
+#if defined(__MBED__)
+  if (_queue != NULL) {
+    _schedule(0);
+  }
+#endif
+
+  _mutex.unlock();
+}
+
+
+/** Continue scrolling after pause()
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Scroller::resume() {
+  _mutex.lock();
+  _paused = false;
+
+#if defined(__MBED__)
+  if (_queue != NULL) {
+    _schedule(_delay());
+  }
+#endif
+
+  _mutex.unlock();
+}
+
+
+/** Advance the message by one digit and update the display
+ *  @param  none
+ *  @return int time in ms until the next step is due, 0 when the message does not scroll
+ */
+int TM1638_Scroller::step() {
+  int last, delay;
+
+  _mutex.lock();
+
+  // Messages that fit are not scrolled
+  if (_length <= _columns) {
+    _mutex.unlock();
+    return 0;
+  }
+
+  last = _length - _columns;
+
+  switch (_mode) {
+    case SCROLL_LOOP:
+      _pos = (_pos + 1) % (_length + _gap);
+      break;
+
+    case SCROLL_PAUSE:
+      _pos = (_pos < last) ? (_pos + 1) : 0;
+      break;
+
+    default:
+      // Bounce, turn around at the ends
+      if (((_pos + _dir) < 0) || ((_pos + _dir) > last)) {
+        _dir = -_dir;
+      }
+      _pos += _dir;
+      break;
+  }
+
+  _show();
+  delay = _delay();
+
+  _mutex.unlock();
+
+  return delay;
+}
+
+
+/** Time until the step after the current position
+ *  @param  none
+ *  @return int time in ms, 0 when the message does not scroll
+ */
+int TM1638_Scroller::_delay() {
+
+  if (_length <= _columns) {
+    return 0;
+  }
+
+  if (_pos == 0) {
+    return _hold;
+  }
+
+  if ((_mode != SCROLL_LOOP) && (_pos == (_length - _columns))) {
+    return _hold;
+  }
+
+  return _step;
+}
+
+
+/** Show the message from its start and restart the step timing
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Scroller::_restart() {
+  _pos = 0;
+  _dir = 1;
+  _show();
+
+#if defined(__MBED__)
+  if ((_queue != NULL) && !_paused) {
+    _schedule(_delay());
+  }
+#endif
+}
+
+
+/** Write the window at the current position, only the digits that changed are sent
+ *  @param  none
+ *  @return none
+ */
+void TM1638_Scroller::_show() {
+  char window[TM1638_MAX_NR_GRIDS];
+  int idx;
+
+  for (int column=0; column < _columns; column++) {
+    idx = _pos + column;
+    if ((_mode == SCROLL_LOOP) && (_length > _columns)) {
+      idx = idx % (_length + _gap);
+    }
+
+    window[column] = (idx < _length) ? _patterns[idx] : 0x00;
+  }
+
+  _display->displayPatterns(window, _columns, 0);
+}
@@ -0,0 +1,215 @@
+/* mbed TM1638 Library, scroll engine for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef TM1638_SCROLL_H
+#define TM1638_SCROLL_H
+#if defined(__MBED__)
+#include "mbed.h"
+#else
+#include "TM1638_Host.h"
+#endif
+#include "TM1638.h"
+
+/** A scroll engine for messages that are longer than the display
+ *
+ * @code
+ * #include "mbed.h"
+ * #include "TM1638_Scroll.h"
+ *
+ * TM1638_LEDKEY8 LEDKEY8(D11, D12, D13, D10);
+ * TM1638_Scroller scroller(LEDKEY8);   // One step per 300 ms, hold 1 s at the ends
+ *
+ * int main() {
+ *   scroller.setMode(TM1638_Scroller::SCROLL_BOUNCE);
+ *   scroller.start();                  // Steps run on the shared event queue
+ *   scroller.setText("Hello World, 3.14");
+ *   ...
+ * }
+ * @endcode
+ */
+
+//Max number of digits of a message, one digit per character with the DPs folded in
+#define TM1638_SCROLL_SIZE      64
+
+//Default time in ms between scroll steps
+#define TM1638_SCROLL_STEP_MS  300
+
+//Default time in ms the message is held at its start and end
+#define TM1638_SCROLL_HOLD_MS 1000
+
+//Default number of blank digits between the end and the start of the message in loop mode
+#define TM1638_SCROLL_GAP        3
+
+
+/** A class for scrolling messages over the display of a TM1638 LED controller
+ *
+ * @brief The message is rendered to segment patterns once by setText(), each step only slides
+ *        the display window over the rendered patterns and sends the digits that changed.
+ *        Messages that fit the display are shown without scrolling. In the background the steps are
+ *        scheduled one at a time on an EventQueue, so the CPU only wakes when a step is due.
+ *        Icons and LEDs are not affected. Works with the LEDKEY8, QYF and LKM1638 boards through the
+ *        renderString(), displayPatterns() and columns() of TM1638.
+ */
+class TM1638_Scroller {
+ public:
+
+  /** Scroll modes
+   */
+  enum ScrollMode {
+    SCROLL_LOOP = 0, /**<  Continuous marquee, the start follows the end after a gap */
+    SCROLL_PAUSE,    /**<  Scroll to the end, hold and jump back to the start */
+    SCROLL_BOUNCE    /**<  Scroll to the end and back, hold at both ends */
+  };
+
+ /** Constructor for class for scrolling messages over the display
+  *
+  *  @param  TM1638 &display display to write, any board with digits
+  *  @param  int step time in ms between scroll steps (default = TM1638_SCROLL_STEP_MS)
+  *  @param  int hold time in ms the message is held at its start and end (default = TM1638_SCROLL_HOLD_MS)
+  */
+  TM1638_Scroller(TM1638 &display, int step = TM1638_SCROLL_STEP_MS, int hold = TM1638_SCROLL_HOLD_MS);
+
+ /** Destructor for class for scrolling messages, cancels a pending step
+  */
+  ~TM1638_Scroller();
+
+#if defined(__MBED__)
+  /** Start scrolling in the background
+   *  @param  EventQueue *queue queue that runs the steps (default = shared event queue)
+   *  @return none
+   */
+  void start(EventQueue *queue = mbed_event_queue());
+
+  /** Stop scrolling in the background, the display keeps the current window
+   *  @param  none
+   *  @return none
+   */
+  void stop();
+#endif
+
+  /** Show a new message from its start
+   *  @param  const char *str characters to show, need not be terminated
+   *  @param  int length number of characters in str
+   *  @return int number of digits of the rendered message
+   */
+  int setText(const char *str, int length);
+
+  /** Show a new zero terminated message from its start
+   *  @param  const char *str zero terminated message
+   *  @return int number of digits of the rendered message
+   */
+  int setText(const char *str) { return setText(str, strlen(str)); }
+
+  /** Show a new message of digit patterns from its start
+   *  @param  const char *patterns one segment pattern per digit, eg from renderString() or TM1638_Number
+   *  @param  int digits number of patterns, at most TM1638_SCROLL_SIZE are kept
+   *  @return int number of digits of the message
+   */
+  int setPatterns(const char *patterns, int digits);
+
+  /** Select the scroll mode
+   *  @param  ScrollMode mode
+   *  @return none
+   */
+  void setMode(ScrollMode mode);
+
+  /** Set the scroll speed
+   *  @param  int step time in ms between scroll steps
+   *  @param  int hold time in ms the message is held at its start and end
+   *  @return none
+   */
+  void setSpeed(int step, int hold);
+
+  /** Set the gap between the end and the start of the message in loop mode, restarts the message
+   *  @param  int gap number of blank digits
+   *  @return none
+   */
+  void setGap(int gap);
+
+  /** Hold the message at the current position
+   *  @param  none
+   *  @return none
+   */
+  void pause();
+
+  /** Continue scrolling after pause()
+   *  @param  none
+   *  @return none
+   */
+  void resume();
+
+  /** Scrolling is paused
+   *  @return bool paused
+   */
+  bool isPaused() const { return _paused; }
+
+  /** Advance the message by one digit and update the display
+   *  @param  none
+   *  @return int time in ms until the next step is due, 0 when the message does not scroll
+   */
+  int step();
+
+ private:
+  TM1638 *_display;
+  int _columns;
+
+  char _patterns[TM1638_SCROLL_SIZE];
+  int _length;
+  int _pos;
+  int _dir;
+
+  int _mode;
+  int _step;
+  int _hold;
+  int _gap;
+  bool _paused;
+
+  PlatformMutex _mutex;
+
+  /** Write the window at the current position
+   */
+  void _show();
+
+  /** Time until the step after the current position
+   */
+  int _delay();
+
+  /** Show the message from its start and restart the step timing
+   */
+  void _restart();
+
+#if defined(__MBED__)
+  EventQueue *_queue;
+  int _id;
+  int _generation;
+
+  /** Schedule the next step, cancels a pending one
+   */
+  void _schedule(int delay);
+
+  /** Step from the event queue
+   */
+  void _queuedStep(int generation);
+#endif
+};
+
+#endif
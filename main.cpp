@@ -23,7 +23,14 @@
  * THE SOFTWARE.
  */
 #include "TM1638.h"
+#include "TM1638_Keys.h"
+#include "TM1638_Scroll.h"
+#include "TM1638_Anim.h"
+#include "TM1638_Fade.h"
+#include "TM1638_Number.h"
+#include "TM1638_Latency.h"
 #include "mbed.h"
+#include "bench.h"
 static BufferedSerial pc(USBTX, USBRX, 115200);
 
 //                          01234567
@@ -56,7 +63,11 @@ TM1638::DisplayData_t bye_str = {C7_B, 0x00, C7_Y, 0x00, C7_E, 0x00,
                                  0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
                                  0x00, 0x00, 0x00, 0x00};
 
-TM1638::DisplayData_t animate[] = {
+// Animation frames and durations stay in flash
+const TM1638::DisplayData_t animate[] = {
+    {0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03, 0xFF, 0x03,
+     0xFF, 0x03, 0xFF, 0x03},
+
     {S7_A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
      0x00, 0x00, 0x00, 0x00},
     {0x00, 0x00, S7_A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
@@ -101,103 +112,138 @@ TM1638::DisplayData_t animate[] = {
     {S7_F, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
      0x00, 0x00, 0x00, 0x00},
 };
-// KeyData_t size is 4 bytes
-TM1638::KeyData_t keydata;
+const uint16_t animate_ms[] = {500, 100, 100, 100, 100, 100, 100, 100, 100, 100, 100,
+                               100, 100, 100, 100, 100, 100, 100, 100, 100, 100};
+const TM1638_Animator::Animation_t animation = {animate, animate_ms, sizeof(animate) / sizeof(animate[0]), 0};
+
+// Key state, bit 0 is SW1
+uint32_t keys;
 
 // TM1638_LEDKEY8 declaration (mosi, miso, sclk, cs SPI bus pins)
 TM1638_LEDKEY8 LEDKEY8(D11, D12, D13, D10);
 
+// Background key scanner, key presses are queued for the main loop
+TM1638_KeyScanner keyscanner(LEDKEY8);
+TM1638_KeyQueue keyqueue;
+TM1638_KeyScanner::KeyEvent_t keyevent;
+
 char cmd0, bits;
 char displayBuffer[40] = "Hello World";
-uint8_t displayPos = 0;
-char currentDisplay[48] = "";
-DigitalOut blueLED(LED2);
+char displayPatterns[LEDKEY8_NR_DIGITS];
+
+// Messages longer than the display scroll by one digit per second
+TM1638_Scroller scroller(LEDKEY8, 1000, 1000);
+
+// Brightness fader
+TM1638_Fader fader(LEDKEY8);
+
+// Animation player, the main loop clears the display when an animation is done
+TM1638_Animator animator(LEDKEY8);
+volatile bool animationDone = false;
+
+void animation_done(bool completed) {
+  (void) completed;   // Cleared either way
+
+  // Cancelled by the next press of SW1, the new animation keeps the display
+  if (animator.isPlaying()) {
+    return;
+  }
+  animationDone = true;
+
+  // The message scrolls again
+  scroller.resume();
+}
+
 void fancy_clear()
 {     
       float delay = 0.1;
       // Icons on
+      LEDKEY8.beginUpdate();
       LEDKEY8.setIcon(TM1638_LEDKEY8::LD1);
       LEDKEY8.setIcon(TM1638_LEDKEY8::DP1);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.setIcon(TM1638_LEDKEY8::LD2);
       LEDKEY8.setIcon(TM1638_LEDKEY8::DP2);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.setIcon(TM1638_LEDKEY8::LD3);
       LEDKEY8.setIcon(TM1638_LEDKEY8::DP3);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.setIcon(TM1638_LEDKEY8::LD4);
       LEDKEY8.setIcon(TM1638_LEDKEY8::DP4);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.setIcon(TM1638_LEDKEY8::LD5);
       LEDKEY8.setIcon(TM1638_LEDKEY8::DP5);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.setIcon(TM1638_LEDKEY8::LD6);
       LEDKEY8.setIcon(TM1638_LEDKEY8::DP6);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.setIcon(TM1638_LEDKEY8::LD7);
       LEDKEY8.setIcon(TM1638_LEDKEY8::DP7);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.setIcon(TM1638_LEDKEY8::LD8);
       LEDKEY8.setIcon(TM1638_LEDKEY8::DP8);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
 
       sprintf(displayBuffer, "%s", "        ");
+      scroller.setText(displayBuffer);
       // Icons off
+      LEDKEY8.beginUpdate();
       LEDKEY8.clrIcon(TM1638_LEDKEY8::LD1);
       LEDKEY8.clrIcon(TM1638_LEDKEY8::DP1);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.clrIcon(TM1638_LEDKEY8::LD2);
       LEDKEY8.clrIcon(TM1638_LEDKEY8::DP2);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.clrIcon(TM1638_LEDKEY8::LD3);
       LEDKEY8.clrIcon(TM1638_LEDKEY8::DP3);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.clrIcon(TM1638_LEDKEY8::LD4);
       LEDKEY8.clrIcon(TM1638_LEDKEY8::DP4);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.clrIcon(TM1638_LEDKEY8::LD5);
       LEDKEY8.clrIcon(TM1638_LEDKEY8::DP5);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.clrIcon(TM1638_LEDKEY8::LD6);
       LEDKEY8.clrIcon(TM1638_LEDKEY8::DP6);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.clrIcon(TM1638_LEDKEY8::LD7);
       LEDKEY8.clrIcon(TM1638_LEDKEY8::DP7);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
+      LEDKEY8.beginUpdate();
       LEDKEY8.clrIcon(TM1638_LEDKEY8::LD8);
       LEDKEY8.clrIcon(TM1638_LEDKEY8::DP8);
+      LEDKEY8.commit();
       ThisThread::sleep_for(100ms);
 
 }
-Thread thread;
-void display_thread()
-{
-  static uint8_t lastPos = 0;
-  static uint8_t screenScroller = 0;
-
-  while (1) {
-    // If string in display buffer is longer than 8 characters then scroll to
-    // end of line once per second
-    screenScroller = (screenScroller + 1) % 10;
-    if (screenScroller == 0) {
-        if ((strlen(displayBuffer) > 8))
-            displayPos = (displayPos + 1) % (strlen(displayBuffer) - 7);
-   
-        else
-            displayPos = 0;
-    }
-    // Update the actual display if displayBuffer has changed or we are scrolling
-    if (strcmp(currentDisplay, displayBuffer) || lastPos != displayPos) {
-//        printf("%d %d - %s\r\n", strlen(displayBuffer), displayPos, displayBuffer);
-        lastPos = displayPos;
-        strcpy(currentDisplay, displayBuffer);
-        LEDKEY8.displayStringAt((char *)(currentDisplay + displayPos), 0);
-        blueLED = !blueLED;
-    }
-
-    ThisThread::sleep_for(100ms);
-  }
-}
 // void displayStringAt(char * inString, int startLoc = 0) {
 //    char outString[22];
 //    for (int i = 0; i < (strlen( inString )) && i < 9; i++) {
@@ -215,43 +261,54 @@ int main() {
   char *buff = new char[1];
   pc.write(msg, sizeof(msg));
 
+#if (BENCH_TEST == 1)
+  bench_run();
+#endif
+
   LEDKEY8.cls();
 //  fancy_clear();
   LEDKEY8.writeData(all_str);
-  ThisThread::sleep_for(2ms);
-  LEDKEY8.setBrightness(TM1638_BRT3);
-  ThisThread::sleep_for(1ms);
-  LEDKEY8.setBrightness(TM1638_BRT0);
-  ThisThread::sleep_for(1ms);
-  LEDKEY8.setBrightness(TM1638_BRT4);
-
-  ThisThread::sleep_for(1ms);
+
+  // Fade in from off while the icons are drawn
+  fader.setLevel(0);
+  fader.fadeTo(TM1638_Fader::levelOf(TM1638_BRT4), 500);
   fancy_clear();
 //  LEDKEY8.cls(true);
   LEDKEY8.writeData(hello_str);
-  thread.start(display_thread);
+  scroller.start();
   strcpy(displayBuffer,"Hello World!");
+  scroller.setText(displayBuffer);
+
+  keyscanner.attach(keyqueue);
+  keyscanner.start();
 
   while (1) {
 
-    // Check and read keydata
-    if (LEDKEY8.getKeys(&keydata)) {
-      printf("Keydata 0..3 = 0x%02x 0x%02x 0x%02x 0x%02x\r\n", keydata[0],
-             keydata[1], keydata[2], keydata[3]);
+    // Restore the display after an animation
+    if (animationDone) {
+      animationDone = false;
+      fancy_clear();
+    }
+
+    // Wait for the next key press, keys pressed during a test are handled afterwards
+    keys = 0;
+    if (keyqueue.wait(&keyevent, 250ms) &&
+        (keyevent.type == TM1638_KeyScanner::KEY_PRESS)) {
+      keys = (1UL << keyevent.key);
 
-      if (keydata[LEDKEY8_SW1_IDX] == LEDKEY8_SW1_BIT) { // sw1
+      printf("Key SW%d, keys down = 0x%02lx\r\n", keyevent.key + 1,
+             (unsigned long) keyscanner.getState());
+
+      if (keys & TM1638_LEDKEY8::SW1) { // sw1
+        // Scroll steps would overwrite the frames, hold the message until animation_done()
+        scroller.pause();
         LEDKEY8.cls();
-        LEDKEY8.writeData(all_str);
 
-        ThisThread::sleep_for(500ms);
-        for (int i = 0; i < 20; i++) {
-          LEDKEY8.writeData(animate[i]);
-          ThisThread::sleep_for(100ms);
-        }
-        fancy_clear();
+        // Keys stay responsive while the animation plays
+        animator.play(animation, TM1638_Animator::ANIM_ONCE, animation_done);
       }
 
-      if (keydata[LEDKEY8_SW2_IDX] == LEDKEY8_SW2_BIT) { // sw2
+      if (keys & TM1638_LEDKEY8::SW2) { // sw2
 
         LEDKEY8.writeData(hello_str);
         // test to show all segs
@@ -281,7 +338,7 @@ int main() {
 #endif
       }
 
-      if (keydata[LEDKEY8_SW3_IDX] == LEDKEY8_SW3_BIT) { // sw3
+      if (keys & TM1638_LEDKEY8::SW3) { // sw3
         //          LEDKEY8.cls();
         //          LEDKEY8.writeData(mbed_str);
 
@@ -289,6 +346,7 @@ int main() {
         fancy_clear();
         printf("Show all NATO Alpha chars\r\n");
         sprintf(displayBuffer,"NATOChar");
+        scroller.setText(displayBuffer);
 //        LEDKEY8.cls(); // clear all, preserve Icons
         while (1) {
           LEDKEY8.locate(0);
@@ -302,6 +360,7 @@ int main() {
            cmd0 = 0x1f & buff[0] - 1; // convert key to array lookup index
          //            pc.write(NATO[cmd0],10);
           sprintf(displayBuffer, "%c - %s", buff[0], (NATO[cmd0]));
+          scroller.setText(displayBuffer);
 
           wait_us(500);
         }
@@ -313,6 +372,7 @@ int main() {
         fancy_clear();
         for (char letter = 65; letter < 65 + 26; letter++) {
           sprintf(displayBuffer, "%c", letter);
+          scroller.setText(displayBuffer);
           //            LEDKEY8.printf("%c", char(i + 'a'));
           ThisThread::sleep_for(250ms);
         }
@@ -325,6 +385,7 @@ int main() {
 
         for (char i = FONT_7S_START; i < FONT_7S_END; i++) {
           sprintf(displayBuffer, "%c", i);
+          scroller.setText(displayBuffer);
           ThisThread::sleep_for(250ms);
           //            wait(0.25);
           //            cmd = getc(); // wait for key
@@ -378,7 +439,7 @@ int main() {
 #endif
     }
 
-    if (keydata[LEDKEY8_SW4_IDX] == LEDKEY8_SW4_BIT) { // sw4
+    if (keys & TM1638_LEDKEY8::SW4) { // sw4
 //          LEDKEY8.cls();
 //          LEDKEY8.writeData(mbed_str);
 #if (1)
@@ -392,16 +453,16 @@ int main() {
       printf("Show all icons done\r\n");
 #endif
     }
-    if (keydata[LEDKEY8_SW5_IDX] == LEDKEY8_SW5_BIT) { // sw5
+    if (keys & TM1638_LEDKEY8::SW5) { // sw5
       fancy_clear();
       printf("Decimal Counting\r\n");
       LEDKEY8.cls(); // clear all, preserve Icons
-      displayPos = 0;
                      //          LEDKEY8.writeData(outputChar);
       for (int cnt = 0; cnt <= 0xFF; cnt++) {
-        if (cnt < 10) sprintf(displayBuffer, "Count  %d", cnt);
-        else if (cnt < 100) sprintf(displayBuffer, "Count %d", cnt);
-        else sprintf(displayBuffer, "Count%d", cnt);
+        // "Count%3d" without sprintf
+        int digits = LEDKEY8.renderString("Count", 5, displayPatterns, LEDKEY8_NR_DIGITS);
+        digits += TM1638_Number::renderInt(cnt, &displayPatterns[digits], LEDKEY8_NR_DIGITS - digits);
+        scroller.setPatterns(displayPatterns, digits);
         ThisThread::sleep_for(200ms);
       }
       printf("Decimal Counting complete\r\n");
@@ -414,7 +475,7 @@ int main() {
               LEDKEY8.printf("hello");
             }
     */
-    if (keydata[LEDKEY8_SW6_IDX] == LEDKEY8_SW6_BIT) { // sw6
+    if (keys & TM1638_LEDKEY8::SW6) { // sw6
 //      LEDKEY8.cls(); // clear all, preserve Icons
       fancy_clear();
       LEDKEY8.writeData(hello_str);
@@ -427,26 +488,40 @@ int main() {
       //          LEDKEY8.printf("Bye");
     }
 
-    if (keydata[LEDKEY8_SW7_IDX] == LEDKEY8_SW7_BIT) { // sw7
+    if (keys & TM1638_LEDKEY8::SW7) { // sw7
       printf("floating point");
       fancy_clear();
 //      LEDKEY8.cls();                         // clear all, preserve Icons
-      sprintf(displayBuffer, " %2.3f", -0.1234); // test decimal point display
+      // test decimal point display
+      scroller.setPatterns(displayPatterns, TM1638_Number::renderFloat(-0.1234f, 3, displayPatterns, LEDKEY8_NR_DIGITS));
       ThisThread::sleep_for(1000ms);
       fancy_clear();
 //      LEDKEY8.cls();                         // clear all, preserve Icons
-      sprintf(displayBuffer, "%2.3f", -012.345); // test decimal point display
+      // test decimal point display
+      scroller.setPatterns(displayPatterns, TM1638_Number::renderFloat(-012.345f, 3, displayPatterns, LEDKEY8_NR_DIGITS));
       ThisThread::sleep_for(2000ms);
       printf("floating point complete");
     }
 
-    if (keydata[LEDKEY8_SW8_IDX] == LEDKEY8_SW8_BIT) { // sw8
+    if (keys & TM1638_LEDKEY8::SW8) { // sw8
 //      LEDKEY8.cls();                         // clear all, preserve Icons
       fancy_clear();
     } // if Key
 
+#if (TM1638_LATENCY == 1)
+    // Console commands: 'l' prints the key to display latency, 'r' resets it
+    if (pc.readable()) {
+      pc.read(buff, 1);
+      if (buff[0] == 'l') {
+        TM1638_latency.print();
+      }
+      if (buff[0] == 'r') {
+        TM1638_latency.reset();
+      }
+    }
+#endif
+
     myled = !myled;
-    ThisThread::sleep_for(250ms);
 
   } // while
 }
@@ -0,0 +1,173 @@
+/* mbed TM1638 Library, number renderer host test
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** Host test of TM1638_Number, the patterns are checked against the printf style text they stand for
+ *
+ * Build and run on the host, the tests/ directory is not part of the mbed build:
+ *   g++ -Wall -Wextra -Iledkey8 -o test_number tests/test_number.cpp ledkey8/TM1638_Number.cpp
+ *   ./test_number
+ */
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "TM1638_Number.h"
+
+static int failed = 0;
+static int checks = 0;
+
+#define CHECK(cond) do { checks++; if (!(cond)) { failed++; printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); } } while (0)
+
+// Patterns as text: digits and hex, '-' and ' ', a '.' adds the DP to the preceding digit
+static bool matches(const char *patterns, int width, const char *text) {
+  static const char digits[16] = {C7_0, C7_1, C7_2, C7_3, C7_4, C7_5, C7_6, C7_7,
+                                  C7_8, C7_9, C7_A, C7_B, C7_C, C7_D, C7_E, C7_F};
+  char expected[TM1638_NUM_MAX_DIGITS + 2];
+  int count = 0;
+
+  for (const char *chr = text; *chr != '\0'; chr++) {
+    if (*chr == '.') {
+      expected[count - 1] |= S7_DP;
+      continue;
+    }
+    if (count >= (int) sizeof(expected)) {
+      return false;
+    }
+    if ((*chr >= '0') && (*chr <= '9')) {
+      expected[count++] = digits[*chr - '0'];
+    }
+    else if ((*chr >= 'A') && (*chr <= 'F')) {
+      expected[count++] = digits[10 + *chr - 'A'];
+    }
+    else if (*chr == '-') {
+      expected[count++] = C7_MIN;
+    }
+    else {
+      expected[count++] = 0x00;
+    }
+  }
+
+  return (count == width) && (memcmp(expected, patterns, width) == 0);
+}
+
+static void test_int() {
+  char patterns[TM1638_NUM_MAX_DIGITS + 2];
+
+  // Width and padding
+  CHECK(TM1638_Number::renderInt(42, patterns, 4) == 4);
+  CHECK(matches(patterns, 4, "  42"));
+  CHECK(TM1638_Number::renderInt(0, patterns, 3) == 3);
+  CHECK(matches(patterns, 3, "  0"));
+  TM1638_Number::renderInt(42, patterns, 4, TM1638_Number::NUM_ZERO);
+  CHECK(matches(patterns, 4, "0042"));
+  TM1638_Number::renderInt(42, patterns, 4, TM1638_Number::NUM_LEFT);
+  CHECK(matches(patterns, 4, "42  "));
+
+  // Sign, zero padding goes between sign and digits
+  TM1638_Number::renderInt(-42, patterns, 5);
+  CHECK(matches(patterns, 5, "  -42"));
+  TM1638_Number::renderInt(-42, patterns, 5, TM1638_Number::NUM_ZERO);
+  CHECK(matches(patterns, 5, "-0042"));
+  TM1638_Number::renderInt(-42, patterns, 5, TM1638_Number::NUM_LEFT);
+  CHECK(matches(patterns, 5, "-42  "));
+  TM1638_Number::renderInt(INT32_MIN, patterns, 11);
+  CHECK(matches(patterns, 11, "-2147483648"));
+
+  // Overflow, the sign needs a digit too
+  CHECK(TM1638_Number::renderInt(12345, patterns, 4) == 4);
+  CHECK(matches(patterns, 4, "----"));
+  TM1638_Number::renderInt(-999, patterns, 4);
+  CHECK(matches(patterns, 4, "-999"));
+  TM1638_Number::renderInt(-1000, patterns, 4);
+  CHECK(matches(patterns, 4, "----"));
+}
+
+static void test_hex() {
+  char patterns[TM1638_NUM_MAX_DIGITS + 2];
+
+  TM1638_Number::renderHex(0x12AB, patterns, 8, TM1638_Number::NUM_ZERO);
+  CHECK(matches(patterns, 8, "000012AB"));
+  TM1638_Number::renderHex(0xFFFFFFFF, patterns, 8);
+  CHECK(matches(patterns, 8, "FFFFFFFF"));
+  TM1638_Number::renderHex(0xC, patterns, 3, TM1638_Number::NUM_LEFT);
+  CHECK(matches(patterns, 3, "C  "));
+  TM1638_Number::renderHex(0x100, patterns, 2);
+  CHECK(matches(patterns, 2, "--"));
+}
+
+static void test_fixed() {
+  char patterns[TM1638_NUM_MAX_DIGITS + 2];
+
+  // The DP takes no digit
+  TM1638_Number::renderFixed(-1234, 2, patterns, 6);
+  CHECK(matches(patterns, 6, " -12.34"));
+  TM1638_Number::renderFixed(5, 3, patterns, 5);
+  CHECK(matches(patterns, 5, " 0.005"));
+  TM1638_Number::renderFixed(-5, 3, patterns, 6, TM1638_Number::NUM_ZERO);
+  CHECK(matches(patterns, 6, "-00.005"));
+  TM1638_Number::renderFixed(-5, 3, patterns, 6, TM1638_Number::NUM_LEFT);
+  CHECK(matches(patterns, 6, "-0.005 "));
+  TM1638_Number::renderFixed(12345, 1, patterns, 4);
+  CHECK(matches(patterns, 4, "----"));
+}
+
+static void test_float() {
+  char patterns[TM1638_NUM_MAX_DIGITS + 2];
+
+  TM1638_Number::renderFloat(-0.1234f, 3, patterns, 8);
+  CHECK(matches(patterns, 8, "   -0.123"));
+  TM1638_Number::renderFloat(-2.5f, 1, patterns, 4, TM1638_Number::NUM_LEFT);
+  CHECK(matches(patterns, 4, "-2.5 "));
+  TM1638_Number::renderFloat(3.0f, 0, patterns, 3, TM1638_Number::NUM_ZERO);
+  CHECK(matches(patterns, 3, "003"));
+
+  // Rounding carries into the whole part
+  TM1638_Number::renderFloat(0.9996f, 3, patterns, 5);
+  CHECK(matches(patterns, 5, " 1.000"));
+  TM1638_Number::renderFloat(-9.96f, 1, patterns, 4);
+  CHECK(matches(patterns, 4, "-10.0"));
+  TM1638_Number::renderFloat(9.9996f, 3, patterns, 4);
+  CHECK(matches(patterns, 4, "----"));
+
+  // A value that rounds to 0 has no sign
+  TM1638_Number::renderFloat(-0.0004f, 3, patterns, 5);
+  CHECK(matches(patterns, 5, " 0.000"));
+
+  // Values that can not be shown
+  CHECK(TM1638_Number::renderFloat(NAN, 2, patterns, 4) == 4);
+  CHECK(matches(patterns, 4, "----"));
+  TM1638_Number::renderFloat(INFINITY, 2, patterns, 4);
+  CHECK(matches(patterns, 4, "----"));
+  TM1638_Number::renderFloat(-INFINITY, 2, patterns, 4);
+  CHECK(matches(patterns, 4, "----"));
+  TM1638_Number::renderFloat(-5e9f, 0, patterns, 10);
+  CHECK(matches(patterns, 10, "----------"));
+}
+
+int main() {
+  test_int();
+  test_hex();
+  test_fixed();
+  test_float();
+
+  printf("%d checks, %d failed\n", checks, failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,159 @@
+/* mbed TM1638 Library, QYF transpose host test
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** Host test of the QYF segment-major layout, checked against a per bit reference on the TM1638_RecorderBus
+ *
+ * Build and run on the host, the tests/ directory is not part of the mbed build:
+ *   g++ -Wall -Wextra -DLEDKEY8_TEST=0 -DQYF_TEST=1 -Iledkey8 -o test_qyf tests/test_qyf.cpp \
+ *       ledkey8/TM1638.cpp ledkey8/TM1638_Bus.cpp ledkey8/Font_7Seg.cpp ledkey8/TM1638_Latency.cpp \
+ *       ledkey8/TM1638_Scroll.cpp
+ *   ./test_qyf
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "TM1638.h"
+#include "TM1638_Bus.h"
+#include "TM1638_Scroll.h"
+#include "Font_7Seg.h"
+
+#if (QYF_TEST != 1)
+#error "Build with -DLEDKEY8_TEST=0 -DQYF_TEST=1"
+#endif
+
+static int failed = 0;
+static int checks = 0;
+
+#define CHECK(cond) do { checks++; if (!(cond)) { failed++; printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); } } while (0)
+
+// Reference layout, one bit at a time: segment n of all digits is held in byte 2n,
+// the bit of Digit 1 is Bit7 and the one of Digit 8 is Bit0
+static void reference(char *memory, int column, char pattern) {
+  char bit = 1 << (7 - column);
+
+  for (int seg=0; seg < 8; seg++) {
+    if (pattern & (1 << seg)) {
+      memory[seg << 1] |= bit;
+    }
+    else {
+      memory[seg << 1] &= ~bit;
+    }
+  }
+}
+
+static void test_transpose(TM1638_RecorderBus &bus, TM1638_QYF &board) {
+  char expected[TM1638_DISPLAY_MEM];
+  char patterns[QYF_NR_DIGITS];
+  int column, digits, bad = 0;
+
+  board.cls(true);
+  memset(expected, 0, TM1638_DISPLAY_MEM);
+
+  srand(1638);
+  for (int run=0; run < 10000; run++) {
+    column = rand() % (QYF_NR_DIGITS + 1);
+    digits = rand() % (QYF_NR_DIGITS + 1);
+    for (int idx=0; idx < QYF_NR_DIGITS; idx++) {
+      patterns[idx] = (char) rand();
+    }
+
+    for (int idx=0; (idx < digits) && ((column + idx) < QYF_NR_DIGITS); idx++) {
+      reference(expected, column + idx, patterns[idx]);
+    }
+    board.displayPatterns(patterns, digits, column);
+
+    // Both the local displaybuffer and the controller memory follow the reference
+    if ((memcmp(expected, board.getDisplayBuffer(), TM1638_DISPLAY_MEM) != 0) ||
+        (memcmp(expected, bus.getDisplay(0), TM1638_DISPLAY_MEM) != 0)) {
+      bad++;
+    }
+  }
+  CHECK(bad == 0);
+}
+
+static void test_render(TM1638_RecorderBus &bus, TM1638_QYF &board) {
+  char expected[TM1638_DISPLAY_MEM];
+  char patterns[QYF_NR_DIGITS];
+
+  // DPs fold into the preceding digit, a leading DP takes a digit of its own
+  CHECK(board.renderString(".1.2..3", 7, patterns, QYF_NR_DIGITS) == 5);
+  CHECK(patterns[0] == (char) S7_DP);
+  CHECK(patterns[1] == (char) (FONT_7S['1' - FONT_7S_START] | S7_DP));
+  CHECK(patterns[2] == (char) (FONT_7S['2' - FONT_7S_START] | S7_DP));
+  CHECK(patterns[3] == (char) S7_DP);
+  CHECK(patterns[4] == (char) FONT_7S['3' - FONT_7S_START]);
+
+  // Rendering stops at the size of the destination
+  CHECK(board.renderString("123456789", 9, patterns, 4) == 4);
+
+  board.cls(true);
+  memset(expected, 0, TM1638_DISPLAY_MEM);
+  bus.clear();
+  CHECK(board.displayStringAt("12.3", 0) == 3);
+  reference(expected, 0, FONT_7S['1' - FONT_7S_START]);
+  reference(expected, 1, FONT_7S['2' - FONT_7S_START] | S7_DP);
+  reference(expected, 2, FONT_7S['3' - FONT_7S_START]);
+  CHECK(memcmp(expected, bus.getDisplay(0), TM1638_DISPLAY_MEM) == 0);
+  CHECK(bus.transactions() <= 2);
+}
+
+static void test_scroll(TM1638_RecorderBus &bus, TM1638_QYF &board) {
+  char expected[TM1638_DISPLAY_MEM];
+  TM1638_Scroller scroller(board, 100, 500);
+
+  board.cls(true);
+  bus.clear();
+
+  // The scroller drives the QYF through the TM1638 interface
+  CHECK(scroller.setText("0123456789") == 10);
+  memset(expected, 0, TM1638_DISPLAY_MEM);
+  for (int column=0; column < QYF_NR_DIGITS; column++) {
+    reference(expected, column, FONT_7S['0' + column - FONT_7S_START]);
+  }
+  CHECK(memcmp(expected, bus.getDisplay(0), TM1638_DISPLAY_MEM) == 0);
+
+  CHECK(scroller.step() == 100);
+  for (int column=0; column < QYF_NR_DIGITS; column++) {
+    reference(expected, column, FONT_7S['1' + column - FONT_7S_START]);
+  }
+  CHECK(memcmp(expected, bus.getDisplay(0), TM1638_DISPLAY_MEM) == 0);
+
+  // Hold at the end, then back to the start
+  CHECK(scroller.step() == 500);
+  CHECK(scroller.step() == 500);
+  for (int column=0; column < QYF_NR_DIGITS; column++) {
+    reference(expected, column, FONT_7S['0' + column - FONT_7S_START]);
+  }
+  CHECK(memcmp(expected, bus.getDisplay(0), TM1638_DISPLAY_MEM) == 0);
+}
+
+int main() {
+  TM1638_RecorderBus bus;
+  TM1638_QYF board(bus, NC);
+
+  test_transpose(bus, board);
+  test_render(bus, board);
+  test_scroll(bus, board);
+
+  printf("%d checks, %d failed\n", checks, failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,356 @@
+/* mbed TM1638 Library, recorder bus host test
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** Host test of the LEDKEY8 traffic, checked against the TM1638_RecorderBus model of the controller
+ *
+ * Build and run on the host, the tests/ directory is not part of the mbed build:
+ *   g++ -Wall -Wextra -pthread -Iledkey8 -o test_recorder tests/test_recorder.cpp ledkey8/TM1638_Anim.cpp ledkey8/TM1638_Dim.cpp \
+ *       ledkey8/TM1638.cpp ledkey8/TM1638_Bus.cpp ledkey8/Font_7Seg.cpp ledkey8/TM1638_Latency.cpp
+ *   ./test_recorder
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <future>
+#include "TM1638.h"
+#include "TM1638_Anim.h"
+#include "TM1638_Dim.h"
+#include "TM1638_Bus.h"
+#include "Font_7Seg.h"
+
+static int failed = 0;
+static int checks = 0;
+
+#define CHECK(cond) do { checks++; if (!(cond)) { failed++; printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond); } } while (0)
+
+// Expose the protected character writer
+class TestLEDKEY8 : public TM1638_LEDKEY8 {
+ public:
+  TestLEDKEY8(TM1638_Bus &bus) : TM1638_LEDKEY8(bus, NC) {}
+  using TM1638_LEDKEY8::_putc;
+};
+
+// Segment pattern of a digit, as stored in the display memory of the controller
+static uint8_t digit(const TM1638_RecorderBus &bus, int column) {
+  return (uint8_t) bus.getDisplay(0)[column * 2];
+}
+
+static void test_cls(TM1638_RecorderBus &bus, TestLEDKEY8 &board) {
+  CHECK(bus.getDspCtrl(0) == (TM1638_DSP_CTRL_CMD | TM1638_DSP_ON | TM1638_BRT_DEF));
+
+  board.cls(true);
+  CHECK(bus.getDataSet(0) == TM1638_DATA_SET_CMD);
+  for (int idx = 0; idx < TM1638_DISPLAY_MEM; idx++) {
+    CHECK(bus.getDisplay(0)[idx] == 0);
+  }
+
+  // Nothing changed, nothing sent
+  bus.clear();
+  board.cls(true);
+  CHECK(bus.transactions() == 0);
+}
+
+static void test_putc(TM1638_RecorderBus &bus, TestLEDKEY8 &board) {
+  board.cls(true);
+  bus.clear();
+
+  board._putc('1');
+  CHECK(digit(bus, 0) == FONT_7S['1' - FONT_7S_START]);
+  // Data set already sent by cls, one address set with the changed byte
+  CHECK(bus.transactions() == 1);
+  CHECK(bus.bytes() == 2);
+  CHECK((uint8_t) bus.getLog()[0] == TM1638_ADDR_SET_CMD);
+  CHECK((uint8_t) bus.getLog()[1] == FONT_7S['1' - FONT_7S_START]);
+
+  // Decimal point merges with the previous digit
+  board._putc('.');
+  CHECK(digit(bus, 0) == (FONT_7S['1' - FONT_7S_START] | (S7_DP1 & 0xFF)));
+
+  board._putc('2');
+  CHECK(digit(bus, 1) == FONT_7S['2' - FONT_7S_START]);
+
+  // Rewriting the same characters only resends the changed byte
+  board.locate(0);
+  bus.clear();
+  board._putc('1');
+  CHECK(bus.transactions() == 1);
+  CHECK(digit(bus, 0) == FONT_7S['1' - FONT_7S_START]);
+
+  // Icons live in the odd bytes
+  board.setIcon(TM1638_LEDKEY8::LD1);
+  CHECK((uint8_t) bus.getDisplay(0)[1] == (S7_LD1 >> 8));
+  board.clrIcon(TM1638_LEDKEY8::LD1);
+  CHECK(bus.getDisplay(0)[1] == 0);
+}
+
+static void test_keys(TM1638_RecorderBus &bus, TestLEDKEY8 &board) {
+  uint32_t held = 0;
+
+  const char none[TM1638_KEY_MEM] = {0, 0, 0, 0};
+  bus.setKeys(0, none);
+  CHECK(!board.getKeys(&held));
+  CHECK(held == 0);
+
+  // SW1 and SW5 share the first keydata byte, SW8 is in the last one
+  const char keys[TM1638_KEY_MEM] = {0x11, 0, 0, 0x10};
+  bus.setKeys(0, keys);
+  bus.clear();
+  CHECK(board.getKeys(&held));
+  CHECK(held == (TM1638_LEDKEY8::SW1 | TM1638_LEDKEY8::SW5 | TM1638_LEDKEY8::SW8));
+  CHECK((uint8_t) bus.getLog()[0] == (TM1638_DATA_SET_CMD | TM1638_KEY_RD));
+  CHECK(bus.getDataSet(0) == (TM1638_DATA_SET_CMD | TM1638_KEY_RD));
+
+  // The next display write restores data write mode
+  board.cls(true);
+  board._putc('8');
+  CHECK(bus.getDataSet(0) == TM1638_DATA_SET_CMD);
+  CHECK(digit(bus, 0) == FONT_7S['8' - FONT_7S_START]);
+}
+
+static void test_flush_mode(TM1638_RecorderBus &bus, TestLEDKEY8 &board) {
+  board.cls(true);
+  board.resetFlushStats();
+  bus.clear();
+
+  // Two scattered LEDs in one batch: one burst over bytes 1..15 costs 17 byte times,
+  // fixed address writes cost 2 * 3 plus 2 for the data set cmd
+  board.beginUpdate();
+  board.setIcon(TM1638_LEDKEY8::LD1);
+  board.setIcon(TM1638_LEDKEY8::LD8);
+  board.commit();
+  CHECK(board.getFlushStats().fixedWrites == 1);
+  CHECK(board.getFlushStats().incWrites == 0);
+  CHECK(bus.getDataSet(0) == (TM1638_DATA_SET_CMD | TM1638_ADDR_FIXED));
+  CHECK(bus.transactions() == 3);
+  CHECK(bus.bytes() == 5);
+  CHECK((uint8_t) bus.getDisplay(0)[1] == (S7_LD1 >> 8));
+  CHECK((uint8_t) bus.getDisplay(0)[15] == (S7_LD8 >> 8));
+
+  // A single byte costs the same in both modes, the controller stays in fixed mode
+  bus.clear();
+  board.clrIcon(TM1638_LEDKEY8::LD8);
+  CHECK(board.getFlushStats().fixedWrites == 2);
+  CHECK(bus.transactions() == 1);
+  CHECK(bus.getDisplay(0)[15] == 0);
+
+  // A dense batch is sent as one burst
+  bus.clear();
+  board.beginUpdate();
+  for (int idx = 0; idx < LEDKEY8_NR_DIGITS; idx++) {
+    board._putc('8');
+  }
+  board.commit();
+  CHECK(board.getFlushStats().incWrites == 1);
+  CHECK(bus.getDataSet(0) == TM1638_DATA_SET_CMD);
+  CHECK(bus.transactions() == 2);
+  for (int idx = 0; idx < LEDKEY8_NR_DIGITS; idx++) {
+    CHECK(digit(bus, idx) == FONT_7S['8' - FONT_7S_START]);
+  }
+}
+
+static void test_frames(TM1638_RecorderBus &bus, TestLEDKEY8 &board) {
+  board.cls(true);
+  bus.clear();
+
+  // Drawing in a frame sends nothing until the outermost present()
+  board.beginFrame();
+  board._putc('1');
+  board.beginFrame();
+  board._putc('2');
+  board.present();
+  CHECK(bus.transactions() == 0);
+  board.present();
+  CHECK(digit(bus, 0) == FONT_7S['1' - FONT_7S_START]);
+  CHECK(digit(bus, 1) == FONT_7S['2' - FONT_7S_START]);
+
+  // A frame inside a batch is presented, the batch still holds back direct writes
+  board.beginUpdate();
+  board.beginFrame();
+  board._putc('3');
+  board.present();
+  CHECK(digit(bus, 2) == FONT_7S['3' - FONT_7S_START]);
+  board._putc('4');
+  CHECK(digit(bus, 3) == 0);
+  board.commit();
+  CHECK(digit(bus, 3) == FONT_7S['4' - FONT_7S_START]);
+
+  // A copy taken by another thread during a frame does not wait, and shows the frame on display
+  TM1638::DisplayData_t copy;
+  board.beginFrame();
+  board._putc('7');
+  std::future<void> other = std::async(std::launch::async, [&] { board.copyDisplayBuffer(copy); });
+  CHECK(other.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+  board.present();
+  other.wait();
+  CHECK((uint8_t) copy[6] == FONT_7S['4' - FONT_7S_START]);
+  CHECK(copy[8] == 0);
+  board.copyDisplayBuffer(copy);
+  CHECK((uint8_t) copy[8] == FONT_7S['7' - FONT_7S_START]);
+
+  // present() without beginFrame() sends the displaybuffer and leaves no frame open
+  board.setDeferred(true);
+  board._putc('5');
+  board.present();
+  board.present();
+  CHECK(digit(bus, 5) == 0);
+  board.setDeferred(false);
+  board.present();
+  CHECK(digit(bus, 5) == FONT_7S['5' - FONT_7S_START]);
+  board._putc('6');
+  CHECK(digit(bus, 6) == FONT_7S['6' - FONT_7S_START]);
+
+  // Deferred, batches and frames are left to the owner of the display writes
+  board.setDeferred(true);
+  board.beginUpdate();
+  board._putc('7');
+  board.commit();
+  board.beginFrame();
+  board._putc('8');
+  board.present();
+  CHECK(digit(bus, 7) == 0);
+  CHECK(digit(bus, 0) == FONT_7S['1' - FONT_7S_START]);
+  board.flush();
+  CHECK(digit(bus, 7) == FONT_7S['7' - FONT_7S_START]);
+  CHECK(digit(bus, 0) == FONT_7S['8' - FONT_7S_START]);
+  board.setDeferred(false);
+}
+
+static void test_dimmer(TM1638_RecorderBus &bus, TestLEDKEY8 &board) {
+  board.cls(true);
+  board._putc('8');
+  board._putc('8');
+
+  // Calibration resends the whole display once, the subframe on the recorder takes well below 1 ms
+  TM1638_Dimmer dimmer(board);
+  bus.clear();
+  CHECK(dimmer.calibrate() == (1000 / (TM1638_DIM_LEVELS * TM1638_DIM_MIN_HZ)));
+  CHECK(bus.bytes() >= (1 + TM1638_DISPLAY_MEM));
+  CHECK(dimmer.getRefreshRate() >= TM1638_DIM_MIN_HZ);
+  CHECK(digit(bus, 0) == FONT_7S['8' - FONT_7S_START]);
+
+  // With many levels the period can not be shorter than 1 ms
+  TM1638_Dimmer fine(board, TM1638_DIM_MAX_LEVELS);
+  CHECK(fine.calibrate() == 1);
+
+  // Digit 1 at half level is shown in every other subframe, digit 2 stays on
+  dimmer.setLevels(0, 2, 2);
+  int shown = 0;
+  for (int idx=0; idx < TM1638_DIM_LEVELS; idx++) {
+    dimmer.subframe();
+    shown += (digit(bus, 0) != 0) ? 1 : 0;
+    CHECK(digit(bus, 1) == FONT_7S['8' - FONT_7S_START]);
+  }
+  CHECK(shown == 2);
+}
+
+static void test_detach() {
+  TM1638_RecorderBus bus;
+  TestLEDKEY8 *first  = new TestLEDKEY8(bus);
+  TestLEDKEY8 *second = new TestLEDKEY8(bus);
+  CHECK(bus.devices() == 2);
+
+  // service() skips the slot of a deleted module
+  delete first;
+  CHECK(bus.devices() == 1);
+  CHECK(bus.service() == 1);
+  CHECK(bus.service() == 1);
+
+  // The free slot is reused
+  TestLEDKEY8 *third = new TestLEDKEY8(bus);
+  CHECK(bus.devices() == 2);
+  CHECK(bus.service() == 0);
+  CHECK(bus.service() == 1);
+
+  delete second;
+  delete third;
+  CHECK(bus.devices() == 0);
+  CHECK(bus.service() == -1);
+}
+
+// Animation of three frames, one digit segment each
+static const TM1638::DisplayData_t anim_frames[] = {
+  {S7_A, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+  {S7_B, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+  {S7_C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+static const TM1638_Animator::Animation_t anim = {anim_frames, NULL, sizeof(anim_frames) / sizeof(anim_frames[0]), 0};
+
+static TM1638_Animator *animator;
+static int anim_done;
+static bool anim_unlocked;
+
+static void anim_finished(bool completed) {
+  anim_done += completed ? 1 : 100;
+
+  // Another thread must get the animator lock, a held lock times out
+  std::future<void> other = std::async(std::launch::async, [] { animator->cancel(); });
+  anim_unlocked = (other.wait_for(std::chrono::seconds(1)) == std::future_status::ready);
+  if (!anim_unlocked) {
+    printf("%s:%d: done callback called with the animator locked\n", __FILE__, __LINE__);
+    exit(1);
+  }
+}
+
+static void test_animator(TM1638_RecorderBus &bus, TestLEDKEY8 &board) {
+  TM1638_Animator player(board);
+  animator = &player;
+
+  board.cls(true);
+  anim_done = 0;
+  player.play(anim, TM1638_Animator::ANIM_ONCE, anim_finished);
+  CHECK(digit(bus, 0) == S7_A);
+  CHECK(player.step() > 0);
+  CHECK(player.step() > 0);
+  CHECK(digit(bus, 0) == S7_C);
+
+  // Completion from step()
+  CHECK(player.step() == 0);
+  CHECK(anim_done == 1);
+  CHECK(anim_unlocked);
+  CHECK(!player.isPlaying());
+
+  // Cancellation by a new play()
+  anim_done     = 0;
+  anim_unlocked = false;
+  player.play(anim, TM1638_Animator::ANIM_LOOP, anim_finished);
+  player.play(anim, TM1638_Animator::ANIM_LOOP);
+  CHECK(anim_done == 100);
+  CHECK(anim_unlocked);
+  player.cancel();
+}
+
+int main() {
+  TM1638_RecorderBus bus;
+  TestLEDKEY8 board(bus);
+
+  test_cls(bus, board);
+  test_putc(bus, board);
+  test_keys(bus, board);
+  test_flush_mode(bus, board);
+  test_frames(bus, board);
+  test_animator(bus, board);
+  test_dimmer(bus, board);
+  test_detach();
+
+  printf("%d checks, %d failed\n", checks, failed);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,169 @@
+/* mbed TM1638 Library, delta animation encoder for TM1638 LED controllers
+ * Copyright (c) 2015, v01: WH, Initial version
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/** Host tool that converts a list of frames into a delta animation for TM1638_Animator
+ *
+ * Build and run on the host, the tools/ directory is not part of the mbed build:
+ *   g++ -Iledkey8 -o tm1638_anim tools/tm1638_anim.cpp ledkey8/TM1638_Anim.cpp \
+ *       ledkey8/TM1638.cpp ledkey8/TM1638_Bus.cpp ledkey8/Font_7Seg.cpp ledkey8/TM1638_Latency.cpp
+ *   ./tm1638_anim spin < spin.txt > spin.h
+ *
+ * Input, one frame per line:  16 display bytes in hex, optionally followed by @ and the duration in ms.
+ *                             Empty lines and lines starting with # are skipped.
+ *   # all segments on for 500 ms, then the A segment of digit 1
+ *   FF 03 FF 03 FF 03 FF 03 FF 03 FF 03 FF 03 FF 03 @500
+ *   01 00 00 00 00 00 00 00 00 00 00 00 00 00 00 00
+ *
+ * Output: a C header with <name>_data, <name>_ms (when any frame has a duration) and the
+ *         TM1638_Animator::DeltaAnimation_t <name>. The sizes are reported on stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "TM1638_Anim.h"
+
+//Max number of frames of one animation
+#define ANIM_MAX_FRAMES  1024
+
+static char frames[ANIM_MAX_FRAMES][TM1638_DISPLAY_MEM];
+static int durations[ANIM_MAX_FRAMES];
+static uint8_t encoded[ANIM_MAX_FRAMES * TM1638_ANIM_MAX_FRAME];
+
+
+/** Parse one frame line
+ *  @param  const char *line text
+ *  @param  char *frame frame of TM1638_DISPLAY_MEM bytes
+ *  @param  int *duration duration in ms, 0 when not given
+ *  @return bool true when the line holds a complete frame
+ */
+static bool parse_frame(const char *line, char *frame, int *duration) {
+  const char *ptr = line;
+  char *end;
+  long value;
+  int bytes = 0;
+
+  *duration = 0;
+
+  while (*ptr != '\0') {
+    if (isspace((unsigned char) *ptr) || (*ptr == ',')) {
+      ptr++;
+    }
+    else if (*ptr == '@') {
+      *duration = (int) strtol(ptr + 1, &end, 10);
+      ptr = end;
+    }
+    else {
+      value = strtol(ptr, &end, 16);
+      if ((end == ptr) || (value < 0) || (value > 0xFF) || (bytes >= TM1638_DISPLAY_MEM)) {
+        return false;
+      }
+      frame[bytes++] = (char) value;
+      ptr = end;
+    }
+  }
+
+  return (bytes == TM1638_DISPLAY_MEM);
+}
+
+
+int main(int argc, char *argv[]) {
+  char line[256], check[TM1638_DISPLAY_MEM];
+  const char *name;
+  int count = 0, size = 0, length, first, last;
+  bool timed = false;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s name [frames.txt] > name.h\n", argv[0]);
+    return 1;
+  }
+  name = argv[1];
+
+  if ((argc > 2) && (freopen(argv[2], "r", stdin) == NULL)) {
+    fprintf(stderr, "%s: can not open %s\n", argv[0], argv[2]);
+    return 1;
+  }
+
+  for (int nr = 1; fgets(line, sizeof(line), stdin) != NULL; nr++) {
+    const char *ptr = line;
+
+    while (isspace((unsigned char) *ptr)) {ptr++;}
+    if ((*ptr == '\0') || (*ptr == '#')) {
+      continue;
+    }
+
+    if (count >= ANIM_MAX_FRAMES) {
+      fprintf(stderr, "%s: more than %d frames\n", argv[0], ANIM_MAX_FRAMES);
+      return 1;
+    }
+    if (!parse_frame(ptr, frames[count], &durations[count])) {
+      fprintf(stderr, "%s: line %d: expected %d hex bytes\n", argv[0], nr, TM1638_DISPLAY_MEM);
+      return 1;
+    }
+    if (durations[count] != 0) {
+      timed = true;
+    }
+    count++;
+  }
+
+  if (count == 0) {
+    fprintf(stderr, "%s: no frames\n", argv[0]);
+    return 1;
+  }
+
+  // Encode and verify that every frame decodes to the original
+  for (int frame = 0; frame < count; frame++) {
+    length = TM1638_Animator::encodeFrame((frame == 0) ? NULL : frames[frame - 1], frames[frame], &encoded[size]);
+    TM1638_Animator::decodeFrame(&encoded[size], check, &first, &last);
+    if (memcmp(check, frames[frame], TM1638_DISPLAY_MEM) != 0) {
+      fprintf(stderr, "%s: frame %d does not decode\n", argv[0], frame);
+      return 1;
+    }
+    size += length;
+  }
+
+  printf("// Generated by tools/tm1638_anim, %d frames\n", count);
+  printf("// raw %d bytes, delta %d bytes\n", count * TM1638_DISPLAY_MEM, size);
+  printf("#include \"TM1638_Anim.h\"\n\n");
+
+  printf("const uint8_t %s_data[%d] = {", name, size);
+  for (int idx = 0; idx < size; idx++) {
+    printf("%s0x%02X%s", ((idx % 12) == 0) ? "\n  " : "", encoded[idx], (idx < (size - 1)) ? ", " : "");
+  }
+  printf("\n};\n\n");
+
+  if (timed) {
+    printf("const uint16_t %s_ms[%d] = {", name, count);
+    for (int frame = 0; frame < count; frame++) {
+      printf("%s%d%s", ((frame % 12) == 0) ? "\n  " : "", durations[frame], (frame < (count - 1)) ? ", " : "");
+    }
+    printf("\n};\n\n");
+  }
+
+  printf("const TM1638_Animator::DeltaAnimation_t %s = {%s_data, %s%s, %d, 0};\n",
+         name, name, timed ? name : "NULL", timed ? "_ms" : "", count);
+
+  fprintf(stderr, "%d frames: raw %d bytes, delta %d bytes (%d%%)\n",
+          count, count * TM1638_DISPLAY_MEM, size, (100 * size) / (count * TM1638_DISPLAY_MEM));
+
+  return 0;
+}